@@ -5,11 +5,21 @@ CONFIG -= qt
 
 INCLUDEPATH += /opt/local/include/
 LIBS += -L/opt/local/lib
-LIBS += -lboost_system-mt -lboost_filesystem-mt
+LIBS += -lboost_system-mt -lboost_filesystem-mt -lboost_thread-mt
 
 SOURCES += main.cpp \
-    neuralnetwork.cpp
+    neuralnetwork.cpp \
+    featureextraction.cpp \
+    viterbidecoder.cpp \
+    datastream.cpp \
+    transport.cpp \
+    sparselayer.cpp
 
 HEADERS += \
-    neuralnetwork.h
+    neuralnetwork.h \
+    featureextraction.h \
+    viterbidecoder.h \
+    datastream.h \
+    transport.h \
+    sparselayer.h
 
@@ -0,0 +1,285 @@
+/* ***************************************************************************************
+ * DATA STREAM: Out of core access to a training or validation set.
+ * The data and label files have the same format as for in memory training (one sample per row),
+ * labels are returned as class indices.
+ * index() scans both files once and remembers where every stripe of stripeSamples_ rows starts,
+ * a stripe being 1/STRIPESPERCHUNK of a chunk. Every epoch the stripes are shuffled and each
+ * chunk is assembled from STRIPESPERCHUNK stripes taken from all over the files, so which
+ * samples share a chunk changes from epoch to epoch even for files sorted by class or speaker.
+ * The samples of each chunk are shuffled as well, while a background thread reads the following
+ * chunk. At most two chunks of the stream are in memory at any time.
+ * Chunks are returned with one sample per column, the layout used by the Neural Network.
+*/
+#include "datastream.h"
+
+DataStream::DataStream()
+{
+    numSamples_ = 0;
+    numFeatures_ = 0;
+    numClasses_ = 0;
+    chunkSamples_ = 0;
+    stripeSamples_ = 0;
+    stripesPerChunk_ = 0;
+    numChunks_ = 0;
+    position_ = 0;
+    shuffleFlag_ = false;
+    generator_.seed((unsigned int)time(0));
+}
+
+DataStream::~DataStream()
+{
+    if(readThread_.joinable())
+        readThread_.join();
+}
+
+void DataStream::readHeader(const char* fileName, size_t& cols){
+
+    ifstream infile;
+    infile.open(fileName);
+    if(!infile.is_open()){
+        cout << "Failed to open file" << endl;
+        exit(1);
+    }
+
+    //number of columns of the first non blank row
+    cols = 0;
+    string line;
+    while(cols == 0 && getline(infile, line)){
+        stringstream stream(line);
+        double value;
+        while(stream >> value)
+            cols++;
+    }
+    infile.close();
+    if(cols == 0){
+        cout << "no samples in file " << fileName << endl;
+        exit(1);
+    }
+}
+
+void DataStream::readLabelHeader(const char* fileName, size_t& classes){
+
+    ifstream infile;
+    infile.open(fileName);
+    if(!infile.is_open()){
+        cout << "Failed to open file" << endl;
+        exit(1);
+    }
+
+    //single column label files only reveal the number of classes through the largest label
+    classes = 0;
+    string line;
+    while(getline(infile, line)){
+        size_t cols = 0;
+        int label = parseLabel(line, cols);
+        if(label < 0)
+            continue;
+        if(cols > 1 && cols > classes)
+            classes = cols;
+        if((size_t)label+1 > classes)
+            classes = label+1;
+    }
+    infile.close();
+}
+
+void DataStream::open(char* dataFile, char* labelFile){
+    dataFile_ = dataFile;
+    labelFile_ = labelFile;
+    readHeader(dataFile, numFeatures_);
+    readLabelHeader(labelFile, numClasses_);
+}
+
+int DataStream::parseLabel(const string& line, size_t& cols){
+
+    //index of the largest value for one-hot rows, the class number minus one for single values
+    const char* p = line.c_str();
+    char* end;
+    double maxValue = 0;
+    int label = -1;
+    cols = 0;
+    while(true){
+        double value = strtod(p, &end);
+        if(end == p)
+            break;
+        if(cols == 0 || value > maxValue){
+            maxValue = value;
+            label = cols;
+        }
+        cols++;
+        p = end;
+    }
+    if(cols == 1)
+        label = (int)floor(maxValue + 0.5) - 1;
+    if(cols == 1 && label < 0){
+        cout << "class numbers in single column label files start at 1" << endl;
+        exit(1);
+    }
+    return label;
+}
+
+void DataStream::indexFile(const char* fileName, std::vector<streampos>& offsets, size_t& rows){
+
+    ifstream infile;
+    infile.open(fileName);
+    if(!infile.is_open()){
+        cout << "Failed to open file" << endl;
+        exit(1);
+    }
+
+    offsets.clear();
+    rows = 0;
+    string line;
+    streampos offset = infile.tellg();
+    while(getline(infile, line)){
+        if(line.find_first_not_of(" \t\r") != string::npos){
+            if(rows % stripeSamples_ == 0)
+                offsets.push_back(offset);
+            rows++;
+        }
+        offset = infile.tellg();
+    }
+    infile.close();
+}
+
+void DataStream::index(size_t chunkSamples){
+
+    //chunks too small to be split keep one row per stripe
+    chunkSamples_ = chunkSamples;
+    stripeSamples_ = chunkSamples_/STRIPESPERCHUNK;
+    if(stripeSamples_ < 1)
+        stripeSamples_ = 1;
+    stripesPerChunk_ = chunkSamples_/stripeSamples_;
+    size_t labelRows = 0;
+    indexFile(dataFile_.c_str(), dataOffsets_, numSamples_);
+    indexFile(labelFile_.c_str(), labelOffsets_, labelRows);
+    if(labelRows != numSamples_){
+        cout << "data file " << dataFile_ << " has " << numSamples_ << " samples but label file has " << labelRows << endl;
+        exit(1);
+    }
+
+    stripeOrder_.resize(dataOffsets_.size());
+    for(size_t s = 0; s < stripeOrder_.size(); s++){
+        stripeOrder_[s] = s;
+    }
+    numChunks_ = (stripeOrder_.size() + stripesPerChunk_ - 1)/stripesPerChunk_;
+    position_ = numChunks_;
+
+    #ifdef DATA_STREAM_DEBUG_INFO
+        cout << "data stream " << dataFile_ << " samples: " << numSamples_ << " chunks: " << numChunks_ << " stripes: " << stripeOrder_.size() << endl;
+    #endif
+}
+
+void DataStream::readRows(ifstream& infile, streampos offset, size_t rows, size_t firstColumn, matrix<double>& m){
+
+    infile.clear();
+    infile.seekg(offset);
+    string line;
+    size_t r = 0;
+    while(r < rows && getline(infile, line)){
+        if(line.find_first_not_of(" \t\r") == string::npos)
+            continue;
+        const char* p = line.c_str();
+        for(size_t c = 0; c < m.size1(); c++){
+            char* end;
+            m(c,firstColumn+r) = strtod(p, &end);
+            p = end;
+        }
+        r++;
+    }
+}
+
+size_t DataStream::stripeRows(size_t stripe){
+    if((stripe+1)*stripeSamples_ > numSamples_)
+        return numSamples_ - stripe*stripeSamples_;
+    return stripeSamples_;
+}
+
+void DataStream::readChunk(size_t chunk){
+
+    size_t first = chunk*stripesPerChunk_;
+    size_t last = std::min(first + stripesPerChunk_, stripeOrder_.size());
+    size_t rows = 0;
+    for(size_t s = first; s < last; s++){
+        rows = rows + stripeRows(stripeOrder_[s]);
+    }
+
+    if(!dataStream_.is_open())
+        dataStream_.open(dataFile_.c_str());
+    if(!labelStream_.is_open())
+        labelStream_.open(labelFile_.c_str());
+
+    nextData_.resize(numFeatures_, rows, false);
+    nextLabels_.clear();
+    size_t column = 0;
+    std::vector<int> labels;
+    for(size_t s = first; s < last; s++){
+        size_t stripe = stripeOrder_[s];
+        readRows(dataStream_, dataOffsets_[stripe], stripeRows(stripe), column, nextData_);
+        readLabelRows(labelStream_, labelOffsets_[stripe], stripeRows(stripe), labels);
+        nextLabels_.insert(nextLabels_.end(), labels.begin(), labels.end());
+        column = column + stripeRows(stripe);
+    }
+}
+
+void DataStream::readLabelRows(ifstream& infile, streampos offset, size_t rows, std::vector<int>& labels){
+
+    infile.clear();
+    infile.seekg(offset);
+    labels.clear();
+    string line;
+    while(labels.size() < rows && getline(infile, line)){
+        size_t cols = 0;
+        int label = parseLabel(line, cols);
+        if(label >= 0)
+            labels.push_back(label);
+    }
+}
+
+void DataStream::shuffle(std::vector<size_t>& order){
+    for(size_t i = order.size(); i > 1; i--){
+        boost::uniform_int<size_t> distribution(0, i-1);
+        size_t j = distribution(generator_);
+        size_t temp = order[i-1];
+        order[i-1] = order[j];
+        order[j] = temp;
+    }
+}
+
+void DataStream::startEpoch(bool shuffle){
+
+    if(readThread_.joinable())
+        readThread_.join();
+
+    shuffleFlag_ = shuffle;
+    if(shuffleFlag_)
+        this->shuffle(stripeOrder_);
+    position_ = 0;
+    if(position_ < numChunks_)
+        readThread_ = boost::thread(&DataStream::readChunk, this, position_);
+}
+
+bool DataStream::nextChunk(matrix<double>& data, std::vector<int>& labels, std::vector<size_t>& order){
+
+    if(position_ >= numChunks_)
+        return false;
+
+    //wait for the read ahead chunk and start reading the one after it
+    readThread_.join();
+    data.swap(nextData_);
+    labels.swap(nextLabels_);
+    position_ = position_ + 1;
+    if(position_ < numChunks_)
+        readThread_ = boost::thread(&DataStream::readChunk, this, position_);
+
+    order.resize(data.size2());
+    for(size_t s = 0; s < order.size(); s++){
+        order[s] = s;
+    }
+    if(shuffleFlag_)
+        shuffle(order);
+
+    #ifdef DATA_STREAM_DEBUG_INFO
+        cout << "data stream " << dataFile_ << " chunk of " << data.size2() << " samples" << endl;
+    #endif
+    return true;
+}
@@ -0,0 +1,80 @@
+#ifndef DATASTREAM_H
+#define DATASTREAM_H
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <ctime>
+#include <cmath>
+#include <algorithm>
+
+// Boost
+#include <boost/numeric/ublas/matrix.hpp>
+#include <boost/thread.hpp>
+#include <boost/random.hpp>
+
+using namespace std;
+using namespace boost::numeric::ublas;
+
+#define STRIPESPERCHUNK 16
+
+//#define DATA_STREAM_DEBUG_INFO
+
+
+/* ***************************************************************************************
+ * Reads a data file and its label file in chunks of at most a fixed number of samples, so data
+ * sets larger than the memory can be used for training. The files are split into stripes of
+ * consecutive rows and a chunk is made of STRIPESPERCHUNK stripes; only the byte offset of every
+ * stripe is kept in memory. While a chunk is used, the next one is read by a background thread.
+*/
+class DataStream
+{
+    void readHeader(const char* fileName, size_t& cols);
+    void readLabelHeader(const char* fileName, size_t& classes);
+    void indexFile(const char* fileName, std::vector<streampos>& offsets, size_t& rows);
+    void readChunk(size_t chunk);
+    size_t stripeRows(size_t stripe);
+    void readRows(ifstream& infile, streampos offset, size_t rows, size_t firstColumn, matrix<double>& m);
+    void readLabelRows(ifstream& infile, streampos offset, size_t rows, std::vector<int>& labels);
+    void shuffle(std::vector<size_t>& order);
+
+    string dataFile_;
+    string labelFile_;
+    std::vector<streampos> dataOffsets_;
+    std::vector<streampos> labelOffsets_;
+
+    //stripe order of the current epoch, chunk c holds the stripes c*stripesPerChunk_ to
+    //(c+1)*stripesPerChunk_-1 of it; position_ is the next chunk to hand out
+    std::vector<size_t> stripeOrder_;
+    size_t stripeSamples_;
+    size_t stripesPerChunk_;
+    size_t numChunks_;
+    size_t position_;
+    bool shuffleFlag_;
+    boost::mt19937 generator_;
+
+    //chunk read ahead by the background thread
+    matrix<double> nextData_;
+    std::vector<int> nextLabels_;
+    boost::thread readThread_;
+    ifstream dataStream_;
+    ifstream labelStream_;
+
+public:
+    DataStream();
+    ~DataStream();
+    void open(char* dataFile, char* labelFile);
+    void index(size_t chunkSamples);
+    void startEpoch(bool shuffle);
+    bool nextChunk(matrix<double>& data, std::vector<int>& labels, std::vector<size_t>& order);
+    static int parseLabel(const string& line, size_t& cols);
+    size_t numSamples_;
+    size_t numFeatures_;
+    size_t numClasses_;
+    size_t chunkSamples_;
+};
+
+#endif // DATASTREAM_H
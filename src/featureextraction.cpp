@@ -0,0 +1,406 @@
+/* ***************************************************************************************
+ * MFCC FRONT END: Converts PCM WAV files into mel frequency cepstral coefficients so that
+ * audio can be fed to the Neural Network without going through an external feature tool.
+ * Every frame of 25ms (shifted by 10ms) is pre-emphasised, weighted by a hamming window and
+ * transformed with a real FFT. The power spectrum is integrated by a triangular mel filterbank,
+ * compressed with a log and decorrelated with a DCT.
+ *
+ * WAV FORMAT: 16 bit PCM, sample rates of 8 to 192 kHz, multi channel files are mixed down to mono.
+ * LIST FORMAT: A .scp list file holds the name of one wav file per row. Every wav file becomes
+ * one row (sample) of the feature matrix, with a fixed number of frames concatenated.
+*/
+#include "featureextraction.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// dot product of two float arrays, used by the mel filterbank and the DCT
+static inline float dotProduct(const float* a, const float* b, int n){
+    int i = 0;
+    float sum = 0;
+#ifdef __SSE2__
+    __m128 acc = _mm_setzero_ps();
+    for(; i + 4 <= n; i += 4){
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(a+i), _mm_loadu_ps(b+i)));
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, acc);
+    sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+    for(; i < n; i++){
+        sum = sum + a[i]*b[i];
+    }
+    return sum;
+}
+
+// little endian readers for the RIFF header
+static unsigned int readUnsigned(const unsigned char* bytes, int numBytes){
+    unsigned int value = 0;
+    for(int i = numBytes-1; i >= 0; i--){
+        value = (value << 8) | bytes[i];
+    }
+    return value;
+}
+
+FeatureExtraction::FeatureExtraction()
+{
+    sampleRate_ = 0;
+    frameLength_ = 0;
+    frameShift_ = 0;
+    fftSize_ = 0;
+    fftBins_ = 0;
+    numCepstra_ = NUMBEROFCEPSTRA;
+    audioSeconds_ = 0;
+    processingSeconds_ = 0;
+}
+
+void FeatureExtraction::readWavFile(const char* fileName){
+
+    ifstream infile(fileName, ios::in | ios::binary);
+    if(!infile.is_open()){
+        cout << "Failed to open wav file " << fileName << endl;
+        exit(1);
+    }
+
+    unsigned char header[12];
+    infile.read((char*)header, 12);
+    if(!infile || memcmp(header,"RIFF",4) != 0 || memcmp(header+8,"WAVE",4) != 0){
+        cout << "not a RIFF/WAVE file " << fileName << endl;
+        exit(1);
+    }
+
+    int channels = 0;
+    int bitsPerSample = 0;
+    int audioFormat = 0;
+    int sampleRate = 0;
+    std::vector<unsigned char> data;
+
+    //walk the chunks until the data chunk is found, odd sized chunks are followed by a pad byte
+    unsigned char chunk[8];
+    bool dataFound = false;
+    while(infile.read((char*)chunk, 8)){
+        unsigned int chunkSize = readUnsigned(chunk+4, 4);
+        if(memcmp(chunk,"fmt ",4) == 0){
+            if(chunkSize < 16){
+                cout << "fmt chunk of " << chunkSize << " bytes is too short in wav file " << fileName << endl;
+                exit(1);
+            }
+            std::vector<unsigned char> fmt(chunkSize);
+            infile.read((char*)&fmt[0], chunkSize);
+            if(!infile){
+                cout << "truncated fmt chunk in wav file " << fileName << endl;
+                exit(1);
+            }
+            audioFormat = readUnsigned(&fmt[0], 2);
+            channels = readUnsigned(&fmt[2], 2);
+            sampleRate = readUnsigned(&fmt[4], 4);
+            bitsPerSample = readUnsigned(&fmt[14], 2);
+            if(chunkSize & 1)
+                infile.seekg(1, ios::cur);
+        }
+        else if(memcmp(chunk,"data",4) == 0){
+            data.resize(chunkSize);
+            if(chunkSize > 0)
+                infile.read((char*)&data[0], chunkSize);
+            data.resize(infile.gcount());
+            dataFound = true;
+            break;
+        }
+        else{
+            infile.seekg(chunkSize + (chunkSize & 1), ios::cur);
+        }
+    }
+    infile.close();
+
+    if(audioFormat != 1 || bitsPerSample != 16 || channels < 1){
+        cout << "only 16 bit PCM wav files are supported: " << fileName << endl;
+        exit(1);
+    }
+    if(sampleRate < MINSAMPLERATE || sampleRate > MAXSAMPLERATE){
+        cout << "sample rate " << sampleRate << " Hz of wav file " << fileName << " is not between " << MINSAMPLERATE << " and " << MAXSAMPLERATE << " Hz" << endl;
+        exit(1);
+    }
+    if(dataFound == false || data.size() < (size_t)(2*channels)){
+        cout << "no audio samples in wav file " << fileName << endl;
+        exit(1);
+    }
+
+    //mix the channels down to mono
+    size_t numSamples = data.size()/(2*channels);
+    samples_.resize(numSamples);
+    for(size_t i = 0; i < numSamples; i++){
+        float sum = 0;
+        for(int c = 0; c < channels; c++){
+            sum = sum + (short)readUnsigned(&data[2*(i*channels+c)], 2);
+        }
+        samples_[i] = sum/channels;
+    }
+
+    if(sampleRate != sampleRate_)
+        setupFrontEnd(sampleRate);
+
+    #ifdef FEATURE_EXTRACTION_DEBUG_INFO
+        cout << "wav file: " << fileName << " sample rate: " << sampleRate << " channels: " << channels << " samples: " << numSamples << endl;
+    #endif
+}
+
+void FeatureExtraction::setupFrontEnd(int sampleRate){
+
+    sampleRate_ = sampleRate;
+    frameLength_ = (int)floor(sampleRate_*FRAMELENGTHMS/1000.0 + 0.5);
+    frameShift_ = (int)floor(sampleRate_*FRAMESHIFTMS/1000.0 + 0.5);
+    fftSize_ = 8;
+    while(fftSize_ < frameLength_)
+        fftSize_ = fftSize_*2;
+    fftBins_ = fftSize_/2 + 1;
+    int halfSize = fftSize_/2;
+
+    //hamming window
+    window_.resize(frameLength_);
+    for(int n = 0; n < frameLength_; n++){
+        window_[n] = 0.54 - 0.46*cos(2*M_PI*n/(frameLength_-1));
+    }
+
+    //the real FFT of fftSize_ points is computed as a complex FFT of halfSize points
+    bitReverse_.resize(halfSize);
+    int bits = 0;
+    while((1 << bits) < halfSize)
+        bits++;
+    for(int i = 0; i < halfSize; i++){
+        int r = 0;
+        for(int b = 0; b < bits; b++){
+            if(i & (1 << b))
+                r |= 1 << (bits-1-b);
+        }
+        bitReverse_[i] = r;
+    }
+
+    //twiddle factors of every butterfly stage stored one after the other, stage h starts at h-1
+    twiddleRe_.resize(halfSize);
+    twiddleIm_.resize(halfSize);
+    for(int h = 1; h < halfSize; h = h*2){
+        for(int j = 0; j < h; j++){
+            twiddleRe_[h-1+j] = cos(M_PI*j/h);
+            twiddleIm_[h-1+j] = -sin(M_PI*j/h);
+        }
+    }
+    realTwiddleRe_.resize(halfSize+1);
+    realTwiddleIm_.resize(halfSize+1);
+    for(int k = 0; k <= halfSize; k++){
+        realTwiddleRe_[k] = cos(2*M_PI*k/fftSize_);
+        realTwiddleIm_[k] = -sin(2*M_PI*k/fftSize_);
+    }
+
+    //triangular filters equally spaced on the mel scale between 0 and the nyquist frequency
+    double melMax = 2595*log10(1 + (sampleRate_/2.0)/700);
+    std::vector<double> centre(NUMBEROFMELFILTERS+2);
+    for(int m = 0; m < NUMBEROFMELFILTERS+2; m++){
+        double mel = melMax*m/(NUMBEROFMELFILTERS+1);
+        centre[m] = 700*(pow(10, mel/2595) - 1);
+    }
+    filterStart_.resize(NUMBEROFMELFILTERS);
+    filterOffset_.resize(NUMBEROFMELFILTERS+1);
+    filterWeight_.clear();
+    for(int m = 0; m < NUMBEROFMELFILTERS; m++){
+        filterOffset_[m] = filterWeight_.size();
+        filterStart_[m] = -1;
+        for(int k = 0; k < fftBins_; k++){
+            double freq = (double)k*sampleRate_/fftSize_;
+            double weight = 0;
+            if(freq > centre[m] && freq <= centre[m+1])
+                weight = (freq - centre[m])/(centre[m+1] - centre[m]);
+            else if(freq > centre[m+1] && freq < centre[m+2])
+                weight = (centre[m+2] - freq)/(centre[m+2] - centre[m+1]);
+            if(weight > 0){
+                if(filterStart_[m] < 0)
+                    filterStart_[m] = k;
+                filterWeight_.resize(k - filterStart_[m] + filterOffset_[m] + 1, 0);
+                filterWeight_[filterOffset_[m] + k - filterStart_[m]] = weight;
+            }
+        }
+        if(filterStart_[m] < 0)
+            filterStart_[m] = 0;
+    }
+    filterOffset_[NUMBEROFMELFILTERS] = filterWeight_.size();
+
+    //DCT-II basis, one row per cepstral coefficient
+    dctMatrix_.resize(numCepstra_*NUMBEROFMELFILTERS);
+    for(int c = 0; c < numCepstra_; c++){
+        double scale = (c == 0) ? sqrt(1.0/NUMBEROFMELFILTERS) : sqrt(2.0/NUMBEROFMELFILTERS);
+        for(int m = 0; m < NUMBEROFMELFILTERS; m++){
+            dctMatrix_[c*NUMBEROFMELFILTERS+m] = scale*cos(M_PI*c*(m+0.5)/NUMBEROFMELFILTERS);
+        }
+    }
+
+    frame_.assign(fftSize_, 0);
+    fftRe_.resize(halfSize);
+    fftIm_.resize(halfSize);
+    power_.resize(fftBins_);
+    melEnergy_.resize(NUMBEROFMELFILTERS);
+
+    #ifdef FEATURE_EXTRACTION_DEBUG_INFO
+        cout << "front end sample rate: " << sampleRate_ << " frame length: " << frameLength_ << " frame shift: " << frameShift_ << " fft size: " << fftSize_ << endl;
+    #endif
+}
+
+void FeatureExtraction::complexFFT(float* re, float* im){
+
+    //iterative radix-2 decimation in time, input already in bit reversed order
+    int n = fftSize_/2;
+    for(int h = 1; h < n; h = h*2){
+        const float* wr = &twiddleRe_[h-1];
+        const float* wi = &twiddleIm_[h-1];
+        for(int k = 0; k < n; k += 2*h){
+            float* ar = re + k;
+            float* ai = im + k;
+            float* br = re + k + h;
+            float* bi = im + k + h;
+            int j = 0;
+#ifdef __SSE2__
+            for(; j + 4 <= h; j += 4){
+                __m128 xr = _mm_loadu_ps(br+j);
+                __m128 xi = _mm_loadu_ps(bi+j);
+                __m128 tr = _mm_loadu_ps(wr+j);
+                __m128 ti = _mm_loadu_ps(wi+j);
+                __m128 vr = _mm_sub_ps(_mm_mul_ps(xr,tr), _mm_mul_ps(xi,ti));
+                __m128 vi = _mm_add_ps(_mm_mul_ps(xr,ti), _mm_mul_ps(xi,tr));
+                __m128 ur = _mm_loadu_ps(ar+j);
+                __m128 ui = _mm_loadu_ps(ai+j);
+                _mm_storeu_ps(ar+j, _mm_add_ps(ur,vr));
+                _mm_storeu_ps(ai+j, _mm_add_ps(ui,vi));
+                _mm_storeu_ps(br+j, _mm_sub_ps(ur,vr));
+                _mm_storeu_ps(bi+j, _mm_sub_ps(ui,vi));
+            }
+#endif
+            for(; j < h; j++){
+                float vr = br[j]*wr[j] - bi[j]*wi[j];
+                float vi = br[j]*wi[j] + bi[j]*wr[j];
+                br[j] = ar[j] - vr;
+                bi[j] = ai[j] - vi;
+                ar[j] = ar[j] + vr;
+                ai[j] = ai[j] + vi;
+            }
+        }
+    }
+}
+
+void FeatureExtraction::powerSpectrum(){
+
+    //split the half size complex spectrum Z into the spectrum X of the real frame
+    int n = fftSize_/2;
+    for(int k = 0; k <= n; k++){
+        float a = fftRe_[k % n];
+        float b = fftIm_[k % n];
+        float c = fftRe_[(n-k) % n];
+        float d = fftIm_[(n-k) % n];
+        float evenRe = 0.5*(a + c);
+        float evenIm = 0.5*(b - d);
+        float oddRe = 0.5*(b + d);
+        float oddIm = -0.5*(a - c);
+        float xr = evenRe + realTwiddleRe_[k]*oddRe - realTwiddleIm_[k]*oddIm;
+        float xi = evenIm + realTwiddleRe_[k]*oddIm + realTwiddleIm_[k]*oddRe;
+        power_[k] = xr*xr + xi*xi;
+    }
+}
+
+void FeatureExtraction::processFrame(const float* samples, float previous, double* cepstra){
+
+    //pre-emphasis and hamming window
+    frame_[0] = (samples[0] - PREEMPHASISCOEFFICIENT*previous)*window_[0];
+    int n = 1;
+#ifdef __SSE2__
+    __m128 alpha = _mm_set1_ps(PREEMPHASISCOEFFICIENT);
+    for(; n + 4 <= frameLength_; n += 4){
+        __m128 x = _mm_sub_ps(_mm_loadu_ps(samples+n), _mm_mul_ps(alpha, _mm_loadu_ps(samples+n-1)));
+        _mm_storeu_ps(&frame_[n], _mm_mul_ps(x, _mm_loadu_ps(&window_[n])));
+    }
+#endif
+    for(; n < frameLength_; n++){
+        frame_[n] = (samples[n] - PREEMPHASISCOEFFICIENT*samples[n-1])*window_[n];
+    }
+
+    //pack even/odd samples as real/imaginary parts in bit reversed order
+    for(int j = 0; j < fftSize_/2; j++){
+        fftRe_[bitReverse_[j]] = frame_[2*j];
+        fftIm_[bitReverse_[j]] = frame_[2*j+1];
+    }
+    complexFFT(&fftRe_[0], &fftIm_[0]);
+    powerSpectrum();
+
+    //mel filterbank and log compression
+    for(int m = 0; m < NUMBEROFMELFILTERS; m++){
+        float energy = dotProduct(&power_[filterStart_[m]], &filterWeight_[filterOffset_[m]], filterOffset_[m+1] - filterOffset_[m]);
+        melEnergy_[m] = log(energy > 1e-10 ? energy : 1e-10);
+    }
+
+    for(int c = 0; c < numCepstra_; c++){
+        cepstra[c] = dotProduct(&dctMatrix_[c*NUMBEROFMELFILTERS], &melEnergy_[0], NUMBEROFMELFILTERS);
+    }
+}
+
+matrix<double> FeatureExtraction::extractFeatures(const char* wavFile){
+
+    readWavFile(wavFile);
+    audioSeconds_ = audioSeconds_ + (double)samples_.size()/sampleRate_;
+
+    //short files are zero padded to a single frame
+    if((int)samples_.size() < frameLength_)
+        samples_.resize(frameLength_, 0);
+    int numFrames = 1 + (samples_.size() - frameLength_)/frameShift_;
+
+    matrix<double> features(numFrames, numCepstra_);
+    std::vector<double> cepstra(numCepstra_);
+    clock_t start = clock();
+    for(int f = 0; f < numFrames; f++){
+        const float* samples = &samples_[f*frameShift_];
+        float previous = (f == 0) ? samples[0] : samples[-1];
+        processFrame(samples, previous, &cepstra[0]);
+        for(int c = 0; c < numCepstra_; c++){
+            features(f,c) = cepstra[c];
+        }
+    }
+    processingSeconds_ = processingSeconds_ + (double)(clock() - start)/CLOCKS_PER_SEC;
+
+    #ifdef FEATURE_EXTRACTION_DEBUG_INFO
+        cout << "extracted " << numFrames << " frames from " << wavFile << endl;
+    #endif
+    return features;
+}
+
+matrix<double> FeatureExtraction::extractFeatureList(const char* listFile, int numFrames){
+
+    ifstream infile;
+    infile.open(listFile);
+    if(!infile.is_open()){
+        cout << "Failed to open file" << endl;
+        exit(1);
+    }
+    std::vector<string> wavFiles;
+    string line;
+    while(getline(infile, line)){
+        size_t end = line.find_last_not_of(" \t\r\n");
+        if(end == string::npos)
+            continue;
+        wavFiles.push_back(line.substr(0, end+1));
+    }
+    infile.close();
+
+    //every wav file is one sample, frames beyond numFrames are dropped and missing frames are zero
+    matrix<double> m = zero_matrix<double>(wavFiles.size(), numFrames*numCepstra_);
+    for(size_t i = 0; i < wavFiles.size(); i++){
+        matrix<double> features = extractFeatures(wavFiles[i].c_str());
+        for(size_t f = 0; f < features.size1() && (int)f < numFrames; f++){
+            for(int c = 0; c < numCepstra_; c++){
+                m(i,f*numCepstra_+c) = features(f,c);
+            }
+        }
+    }
+    return m;
+}
+
+void FeatureExtraction::printRealTimeFactor(){
+    cout << "Feature extraction processed " << audioSeconds_ << " seconds of audio in " << processingSeconds_ << " seconds" << endl;
+    if(audioSeconds_ > 0)
+        cout << "Feature extraction real time factor: " << processingSeconds_/audioSeconds_ << endl;
+}
@@ -0,0 +1,83 @@
+#ifndef FEATUREEXTRACTION_H
+#define FEATUREEXTRACTION_H
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <cmath>
+
+// Boost
+#include <boost/numeric/ublas/matrix.hpp>
+
+using namespace std;
+using namespace boost::numeric::ublas;
+
+#define PREEMPHASISCOEFFICIENT 0.97
+#define FRAMELENGTHMS 25.0
+#define FRAMESHIFTMS 10.0
+#define MINSAMPLERATE 8000
+#define MAXSAMPLERATE 192000
+#define NUMBEROFMELFILTERS 26
+#define NUMBEROFCEPSTRA 13
+
+//#define FEATURE_EXTRACTION_DEBUG_INFO
+
+
+/* ***************************************************************************************
+ * MFCC front end: reads a PCM WAV file and computes one row of cepstral coefficients per
+ * frame (pre-emphasis, framing, hamming window, real FFT, mel filterbank, log and DCT).
+ * The hot loops are written with SSE intrinsics and fall back to scalar code when the
+ * compiler does not target SSE.
+*/
+class FeatureExtraction
+{
+    void readWavFile(const char* fileName);
+    void setupFrontEnd(int sampleRate);
+    void processFrame(const float* samples, float previous, double* cepstra);
+    void complexFFT(float* re, float* im);
+    void powerSpectrum();
+
+    //samples of the last wav file read, mixed down to mono
+    std::vector<float> samples_;
+    int sampleRate_;
+
+    //front end tables, rebuilt whenever the sample rate changes
+    int frameLength_;
+    int frameShift_;
+    int fftSize_;
+    int fftBins_;
+    std::vector<float> window_;
+    std::vector<float> twiddleRe_;
+    std::vector<float> twiddleIm_;
+    std::vector<float> realTwiddleRe_;
+    std::vector<float> realTwiddleIm_;
+    std::vector<int> bitReverse_;
+    std::vector<int> filterStart_;
+    std::vector<int> filterOffset_;
+    std::vector<float> filterWeight_;
+    std::vector<float> dctMatrix_;
+
+    //scratch buffers used for every frame
+    std::vector<float> frame_;
+    std::vector<float> fftRe_;
+    std::vector<float> fftIm_;
+    std::vector<float> power_;
+    std::vector<float> melEnergy_;
+
+    //statistics used to report the real time factor
+    double audioSeconds_;
+    double processingSeconds_;
+
+public:
+    FeatureExtraction();
+    matrix<double> extractFeatures(const char* wavFile);
+    matrix<double> extractFeatureList(const char* listFile, int numFrames);
+    void printRealTimeFactor();
+    int numCepstra_;
+};
+
+#endif // FEATUREEXTRACTION_H
@@ -17,12 +17,24 @@ int main(int argc, char** argv)
             neuralNetwork->exit_with_help();
         }else { // if we got enough parameters...
             neuralNetwork->parse_command_line(argc,argv);
-            if(neuralNetwork->trainTestFlag_ == 0)
+            if(neuralNetwork->trainTestFlag_ == TRAIN_MODE)
                 neuralNetwork->trainValidateNeuralNetwork();
-            if(neuralNetwork->trainTestFlag_ == 1){
+            if(neuralNetwork->trainTestFlag_ == TEST_MODE){
                 neuralNetwork->loadTrainedModel();
                 neuralNetwork->testNeuralNetwork();
             }
+            if(neuralNetwork->trainTestFlag_ == EXTRACT_MODE)
+                neuralNetwork->extractFeatures();
+            if(neuralNetwork->trainTestFlag_ == SWEEP_MODE)
+                neuralNetwork->sweepNeuralNetwork();
+            if(neuralNetwork->trainTestFlag_ == CROSSVALIDATION_MODE)
+                neuralNetwork->crossValidateNeuralNetwork();
+            if(neuralNetwork->trainTestFlag_ == DISTRIBUTED_MODE)
+                neuralNetwork->distributedTrainNeuralNetwork();
+            if(neuralNetwork->trainTestFlag_ == DECODE_MODE){
+                neuralNetwork->loadTrainedModel();
+                neuralNetwork->decodeNeuralNetwork();
+            }
         }
     }catch(const std::exception& e) {
         nret = 0;
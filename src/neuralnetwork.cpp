@@ -30,6 +30,10 @@
  * TESTING LABEL FILE: Each row in the label file represents the label of the coresponding sample in the data file.
  * MODEL FILE: The trained parameters of the NN are loaded from this file
  *
+ * WAV LIST FILES: Any data file with the extension .scp is read as a list of wav files, one per row.
+ * The MFCC front end (featureextraction.cpp) converts every wav file into one sample of the data
+ * set in memory, so raw audio can be used for training and testing directly.
+ *
  * created by Mitesh Patel on <March 2007>
  * amended by Mitesh Patel on <Feb 2014>
 */
@@ -38,7 +42,7 @@
 NeuralNetwork::NeuralNetwork()
 {
     bestIndex_ = 1;
-    lowestError_ = 100;
+    lowestError_ = DBL_MAX;
     hiddenNodes_ = 0;
     inputNodes_ = 0;
     outputNodes_ = 0;
@@ -50,36 +54,717 @@ NeuralNetwork::NeuralNetwork()
     predictionCount_ = 0;
     hiddenNodeDefaultFlag_ = 0;
     verbose_ = 0;
+    featureFrames_ = NUMBEROFFEATUREFRAMES;
+    featureExtractionFlag_ = 0;
+    maxMemory_ = 0;
+    printInfoFlag_ = true;
+    numThreads_ = boost::thread::hardware_concurrency();
+    sweepConfigFile_ = NULL;
+    numFolds_ = CROSSVALIDATIONFOLDS;
+    validationMistakes_ = 0;
+    classificationError_ = 0;
+    bestClassificationError_ = 0;
+    rank_ = -1;
+    worldSize_ = DISTRIBUTEDPROCESSES;
+    syncInterval_ = SYNCINTERVAL;
+    scalingFlag_ = false;
+    hogwildThreads_ = 0;
+    pruneCycles_ = 0;
+    patience_ = 0;
+    initModelFile_ = NULL;
+    traceFile_ = NULL;
+    traceFileName_ = NULL;
 }
 
 void NeuralNetwork::trainValidateNeuralNetwork(){
 
+    if(maxMemory_ > 0 && pruneList_.size() > 0){
+        cout << "--prune needs the validation data in memory and cannot be used with --max-memory" << endl;
+        exit(1);
+    }
+
+    if(maxMemory_ > 0){
+        trainValidateNeuralNetworkOutOfCore();
+    }else{
+        loadTrainingData();
+        trainCycles();
+        printTrainedModel();
+        saveTrainedModel();
+    }
+    if(traceFile_ != NULL){
+        fclose(traceFile_);
+        traceFile_ = NULL;
+    }
+    if(pruneList_.size() > 0)
+        pruneNeuralNetwork();
+    //cout << "Neural network trained and model parameters saved in file named " << modelFile_ << endl;
+}
+
+void NeuralNetwork::loadTrainingData(){
+
     // Loading training and validation data and corresponding label files
-    trainingData_ = loadDataSet(trainingDataFile_);
-    trainingData_ = trans(trainingData_);
-    trainingLabels_ = loadDataSet(trainingDataFileLabel_);
-    trainingLabels_ = trans(trainingLabels_);
-    validationData_ = loadDataSet(validationDataFile_);
-    validationData_ = trans(validationData_);
-    validationLabels_ = loadDataSet(validationDataFileLabel_);
-    validationLabels_ = trans(validationLabels_);
+    trainingData_.reset(new matrix<double>(trans(loadDataSet(trainingDataFile_))));
+    trainingLabels_.reset(new std::vector<int>(loadLabelSet(trainingDataFileLabel_, outputNodes_)));
+    validationData_.reset(new matrix<double>(trans(loadDataSet(validationDataFile_))));
+    int validationClasses = 0;
+    validationLabels_.reset(new std::vector<int>(loadLabelSet(validationDataFileLabel_, validationClasses)));
 
     #ifdef NEURAL_NETWORK_PARAMETER_DEBUG_INFO
-        cout << "matrix training data size: " << trainingData_.size1() << " rows and " << trainingData_.size2() << " columns" << endl;
-        cout << "matrix training labels size: " << trainingLabels_.size1() << " rows and " << trainingLabels_.size2() << " columns" << endl;
-        cout << "matrix validation data size: " << validationData_.size1() << " rows and " << validationData_.size2() << " columns" << endl;
-        cout << "matrix validation label size: " << validationLabels_.size1() << " rows and " << validationLabels_.size2() << " columns" << endl;
+        if(featureExtractionFlag_ == true)
+            featureExtraction_.printRealTimeFactor();
+        cout << "matrix training data size: " << trainingData_->size1() << " rows and " << trainingData_->size2() << " columns" << endl;
+        cout << "training labels: " << trainingLabels_->size() << " samples of " << outputNodes_ << " classes, " << trainingLabels_->size()*sizeof(int) << " bytes (one-hot double matrix: " << trainingLabels_->size()*outputNodes_*sizeof(double) << " bytes)" << endl;
+        cout << "matrix validation data size: " << validationData_->size1() << " rows and " << validationData_->size2() << " columns" << endl;
+        cout << "validation labels: " << validationLabels_->size() << " samples, " << validationLabels_->size()*sizeof(int) << " bytes (one-hot double matrix: " << validationLabels_->size()*outputNodes_*sizeof(double) << " bytes)" << endl;
     #endif
 
     //Defining Neural Network Parameters i.e. number of input nodes, hidden nodes and output nodes based on the training data
-    inputNodes_ = (trainingData_.size1())+1;
-    outputNodes_ = trainingLabels_.size1();
+    inputNodes_ = (trainingData_->size1())+1;
+    if(trainingLabels_->size() != trainingData_->size2() || validationLabels_->size() != validationData_->size2()){
+        cout << "number of labels does not match the number of samples" << endl;
+        exit(1);
+    }
+    if(validationClasses > outputNodes_){
+        cout << "validation labels have more classes than the training labels" << endl;
+        exit(1);
+    }
+
+    trainingOrder_.resize(trainingData_->size2());
+    for(size_t s = 0; s < trainingOrder_.size(); s++){
+        trainingOrder_[s] = s;
+    }
+    validationOrder_.resize(validationData_->size2());
+    for(size_t s = 0; s < validationOrder_.size(); s++){
+        validationOrder_[s] = s;
+    }
+}
+
+void NeuralNetwork::trainCycles(){
+
+    initialiseWeights();
+    for(size_t c = 0; c < numCycle_; c++){
+        validateNeuralNetwork(); // validate the neural network with validation data
+        if(patience_ > 0 && cycle_ - bestIndex_ >= patience_){
+            if(printInfoFlag_ == true)
+                cout << "validation error did not improve for " << patience_ << " cycles, training stopped at interation number: " << cycle_ << endl;
+            break;
+        }
+        trainNeuralNetwork();    // train the neural network with training data
+        cycle_ = cycle_ + 1;
+    }//for(size_t c = 0; c < numCycle_; c++)
+}
+
+void NeuralNetwork::trainValidateNeuralNetworkOutOfCore(){
+
+    if(isWavList(trainingDataFile_) || isWavList(validationDataFile_)){
+        cout << "wav lists cannot be used with --max-memory, extract the features with -t extract first" << endl;
+        exit(1);
+    }
+
+    trainingStream_.open(trainingDataFile_, trainingDataFileLabel_);
+    validationStream_.open(validationDataFile_, validationDataFileLabel_);
+    inputNodes_ = trainingStream_.numFeatures_+1;
+    outputNodes_ = trainingStream_.numClasses_;
+    if(validationStream_.numFeatures_ != trainingStream_.numFeatures_){
+        cout << "training and validation files have different number of columns" << endl;
+        exit(1);
+    }
+    if(validationStream_.numClasses_ > trainingStream_.numClasses_){
+        cout << "validation labels have more classes than the training labels" << endl;
+        exit(1);
+    }
+    initialiseWeights();
+    trainingData_.reset(new matrix<double>());
+    trainingLabels_.reset(new std::vector<int>());
+    validationData_.reset(new matrix<double>());
+    validationLabels_.reset(new std::vector<int>());
+
+    //weights, best weights and the per sample updates stay resident, the rest of the
+    //budget holds the current and read ahead chunks of the training and validation data
+    double weightBytes = 4.0*sizeof(double)*((hiddenNodes_-1)*inputNodes_ + outputNodes_*hiddenNodes_);
+    double sampleBytes = sizeof(double)*inputNodes_ + sizeof(int) + sizeof(size_t);
+    double budget = maxMemory_*1024*1024 - weightBytes;
+    size_t chunkSamples = (budget > 0) ? (size_t)(budget/(4*sampleBytes)) : 0;
+    if(chunkSamples < 1){
+        cout << "--max-memory of " << maxMemory_ << " MB is too small for the network weights" << endl;
+        exit(1);
+    }
+    trainingStream_.index(chunkSamples);
+    validationStream_.index(chunkSamples);
+
+    #ifdef NEURAL_NETWORK_PARAMETER_DEBUG_INFO
+        cout << "out of core training samples: " << trainingStream_.numSamples_ << " validation samples: " << validationStream_.numSamples_ << endl;
+        cout << "samples per chunk: " << chunkSamples << " resident memory bound: " << (weightBytes + 4*chunkSamples*sampleBytes)/(1024*1024) << " MB" << endl;
+    #endif
+
+    for(int c = 0; c < numCycle_; c++){
+
+        //validation error over all validation chunks
+        double error = 0;
+        validationMistakes_ = 0;
+        validationStream_.startEpoch(false);
+        while(validationStream_.nextChunk(*validationData_, *validationLabels_, validationOrder_)){
+            error = error + validationError();
+        }
+        eValidation_(0,cycle_) = error/validationStream_.numSamples_;
+        classificationError_ = (double)validationMistakes_/validationStream_.numSamples_;
+        updateBestWeights();
+        if(patience_ > 0 && cycle_ - bestIndex_ >= patience_){
+            if(printInfoFlag_ == true)
+                cout << "validation error did not improve for " << patience_ << " cycles, training stopped at interation number: " << cycle_ << endl;
+            break;
+        }
+
+        //training chunks in random order, samples shuffled within each chunk
+        trainingStream_.startEpoch(true);
+        while(trainingStream_.nextChunk(*trainingData_, *trainingLabels_, trainingOrder_)){
+            trainNeuralNetwork();
+        }
+        cycle_ = cycle_ + 1;
+    }
+
+    printTrainedModel();
+    saveTrainedModel();
+}
+
+// values of a comma separated list such as "5,7,9"
+static std::vector<double> parseList(const string& list, double defaultValue){
+    std::vector<double> values;
+    stringstream stream(list);
+    string item;
+    while(getline(stream, item, ',')){
+        if(item.size() > 0)
+            values.push_back(atof(item.c_str()));
+    }
+    if(values.size() == 0)
+        values.push_back(defaultValue);
+    return values;
+}
+
+void NeuralNetwork::shareTrainingData(NeuralNetwork& worker){
+
+    //the worker reads the same data set, nothing is copied
+    worker.trainingData_ = trainingData_;
+    worker.trainingLabels_ = trainingLabels_;
+    worker.validationData_ = validationData_;
+    worker.validationLabels_ = validationLabels_;
+    worker.trainingOrder_ = trainingOrder_;
+    worker.validationOrder_ = validationOrder_;
+    worker.inputNodes_ = inputNodes_;
+    worker.outputNodes_ = outputNodes_;
+    worker.printInfoFlag_ = false;
+}
+
+void NeuralNetwork::runJobs(std::vector<NeuralNetwork*>* jobs, size_t* nextJob, boost::mutex* jobMutex){
+    while(true){
+        size_t job;
+        {
+            boost::mutex::scoped_lock lock(*jobMutex);
+            job = *nextJob;
+            *nextJob = *nextJob + 1;
+        }
+        if(job >= jobs->size())
+            break;
+        (*jobs)[job]->trainCycles();
+    }
+}
+
+void NeuralNetwork::runConcurrently(std::vector<NeuralNetwork*>& jobs, int numThreads){
+
+    //a pool of threads takes the networks to train one after the other
+    if(numThreads < 1)
+        numThreads = 1;
+    size_t nextJob = 0;
+    boost::mutex jobMutex;
+    boost::thread_group pool;
+    for(int t = 0; t < numThreads && t < (int)jobs.size(); t++){
+        pool.create_thread(boost::bind(&NeuralNetwork::runJobs, &jobs, &nextJob, &jobMutex));
+    }
+    pool.join_all();
+}
+
+void NeuralNetwork::sweepNeuralNetwork(){
+
+    loadTrainingData();
+
+    //configurations from the --configs file or the grid of the -h -l -c lists
+    std::vector<int> hiddenNodes;
+    std::vector<double> learnRates;
+    std::vector<int> cycles;
+    if(sweepConfigFile_ != NULL){
+        ifstream infile;
+        infile.open(sweepConfigFile_);
+        if(!infile.is_open()){
+            cout << "Failed to open file" << endl;
+            exit(1);
+        }
+        string line;
+        while(getline(infile, line)){
+            stringstream stream(line);
+            int h, c;
+            double l;
+            if(stream >> h >> l >> c){
+                hiddenNodes.push_back(h);
+                learnRates.push_back(l);
+                cycles.push_back(c);
+            }
+        }
+        infile.close();
+    }else{
+        std::vector<double> hiddenList = parseList(hiddenNodeList_, 0);
+        std::vector<double> learnRateList = parseList(learnRateList_, LEARNINGCONSTANT);
+        std::vector<double> cycleList = parseList(cycleList_, NUMBEROFTRAININGCYCLE);
+        for(size_t h = 0; h < hiddenList.size(); h++){
+            for(size_t l = 0; l < learnRateList.size(); l++){
+                for(size_t c = 0; c < cycleList.size(); c++){
+                    hiddenNodes.push_back((int)hiddenList[h]);
+                    learnRates.push_back(learnRateList[l]);
+                    cycles.push_back((int)cycleList[c]);
+                }
+            }
+        }
+    }
+    if(hiddenNodes.size() == 0){
+        cout << "no configurations to sweep" << endl;
+        exit(1);
+    }
+
+    std::vector<boost::shared_ptr<NeuralNetwork> > workers;
+    std::vector<NeuralNetwork*> jobs;
+    std::vector<string> modelFiles;
+    for(size_t k = 0; k < hiddenNodes.size(); k++){
+        boost::shared_ptr<NeuralNetwork> worker(new NeuralNetwork());
+        shareTrainingData(*worker);
+        worker->hiddenNodeDefaultFlag_ = (hiddenNodes[k] > 0);
+        worker->hiddenNodes_ = hiddenNodes[k];
+        worker->learnRate_ = learnRates[k];
+        worker->numCycle_ = cycles[k];
+        workers.push_back(worker);
+        jobs.push_back(worker.get());
+
+        char name[1024];
+        snprintf(name, sizeof(name), "%s.h%d_l%g_c%d", modelFile_, hiddenNodes[k], learnRates[k], cycles[k]);
+        modelFiles.push_back(name);
+    }
+
+    #ifdef NEURAL_NETWORK_PARAMETER_DEBUG_INFO
+        cout << "sweeping " << jobs.size() << " configurations on " << numThreads_ << " threads" << endl;
+    #endif
+    runConcurrently(jobs, numThreads_);
+
+    //save the best model of every configuration and rank them by validation error
+    std::vector<std::pair<double,size_t> > ranking;
+    for(size_t k = 0; k < workers.size(); k++){
+        workers[k]->modelFile_ = &modelFiles[k][0];
+        workers[k]->saveTrainedModel();
+        ranking.push_back(std::make_pair(workers[k]->lowestError_, k));
+    }
+    std::sort(ranking.begin(), ranking.end());
+
+    string summaryFile = string(modelFile_) + ".summary";
+    FILE *fp = fopen(summaryFile.c_str(),"w");
+    if(fp==NULL){
+        cout << "cannot write n the file" << endl;
+        exit(1);
+    }
+    fprintf(fp,"rank hidden_Nodes learning_Rate Training_Cycles Best_weights_at_interation_number validation_Error model_File\n");
+    printf("rank hidden_Nodes learning_Rate Training_Cycles Best_weights_at_interation_number validation_Error model_File\n");
+    for(size_t r = 0; r < ranking.size(); r++){
+        NeuralNetwork* worker = workers[ranking[r].second].get();
+        fprintf(fp,"%d %d %g %d %d %.6g %s\n", (int)r+1, worker->hiddenNodes_, worker->learnRate_, worker->numCycle_, worker->bestIndex_, worker->lowestError_, worker->modelFile_);
+        printf("%d %d %g %d %d %.6g %s\n", (int)r+1, worker->hiddenNodes_, worker->learnRate_, worker->numCycle_, worker->bestIndex_, worker->lowestError_, worker->modelFile_);
+    }
+    if (ferror(fp) != 0 || fclose(fp) != 0){
+        cout << "error in writing the sweep summary to the file" << endl;
+        exit(1);
+    }
+    cout << "Sweep summary saved in file named: " << summaryFile << endl;
+}
+
+void NeuralNetwork::crossValidateNeuralNetwork(){
+
+    boost::posix_time::ptime startTime = boost::posix_time::microsec_clock::universal_time();
+
+    //the data set is loaded once and used for training and validation, folds only differ in their orders
+    trainingData_.reset(new matrix<double>(trans(loadDataSet(trainingDataFile_))));
+    trainingLabels_.reset(new std::vector<int>(loadLabelSet(trainingDataFileLabel_, outputNodes_)));
+    validationData_ = trainingData_;
+    validationLabels_ = trainingLabels_;
+    inputNodes_ = (trainingData_->size1())+1;
+    size_t numSamples = trainingData_->size2();
+    if(trainingLabels_->size() != numSamples){
+        cout << "number of labels does not match the number of samples" << endl;
+        exit(1);
+    }
+    if(numFolds_ < 2 || numFolds_ > (int)numSamples){
+        cout << "number of folds must be between 2 and the number of samples" << endl;
+        exit(1);
+    }
+
+    //samples are assigned to folds in random order
+    std::vector<size_t> permutation(numSamples);
+    for(size_t s = 0; s < numSamples; s++){
+        permutation[s] = s;
+    }
+    boost::mt19937 generator;
+    generator.seed((unsigned int)time(0));
+    for(size_t s = numSamples; s > 1; s--){
+        boost::uniform_int<size_t> distribution(0, s-1);
+        std::swap(permutation[s-1], permutation[distribution(generator)]);
+    }
+
+    std::vector<boost::shared_ptr<NeuralNetwork> > workers;
+    std::vector<NeuralNetwork*> jobs;
+    for(int f = 0; f < numFolds_; f++){
+        boost::shared_ptr<NeuralNetwork> worker(new NeuralNetwork());
+        shareTrainingData(*worker);
+        worker->trainingOrder_.clear();
+        worker->validationOrder_.clear();
+        for(size_t s = 0; s < numSamples; s++){
+            if((int)(s % numFolds_) == f)
+                worker->validationOrder_.push_back(permutation[s]);
+            else
+                worker->trainingOrder_.push_back(permutation[s]);
+        }
+        worker->hiddenNodeDefaultFlag_ = hiddenNodeDefaultFlag_;
+        worker->hiddenNodes_ = hiddenNodes_;
+        worker->learnRate_ = learnRate_;
+        worker->numCycle_ = numCycle_;
+        workers.push_back(worker);
+        jobs.push_back(worker.get());
+    }
+
+    #ifdef NEURAL_NETWORK_PARAMETER_DEBUG_INFO
+        cout << "cross validating " << numFolds_ << " folds of " << numSamples << " samples on " << numThreads_ << " threads" << endl;
+    #endif
+    boost::posix_time::ptime trainingTime = boost::posix_time::microsec_clock::universal_time();
+    runConcurrently(jobs, numThreads_);
+    boost::posix_time::ptime endTime = boost::posix_time::microsec_clock::universal_time();
+
+    //per fold and aggregate errors of the best weights of every fold
+    double meanError = 0, meanClassification = 0;
+    printf("fold training_Samples validation_Samples Best_weights_at_interation_number validation_Error classification_Error\n");
+    for(int f = 0; f < numFolds_; f++){
+        NeuralNetwork* worker = workers[f].get();
+        printf("%d %d %d %d %.6g %.2f%%\n", f+1, (int)worker->trainingOrder_.size(), (int)worker->validationOrder_.size(), worker->bestIndex_, worker->lowestError_, 100*worker->bestClassificationError_);
+        meanError = meanError + worker->lowestError_/numFolds_;
+        meanClassification = meanClassification + worker->bestClassificationError_/numFolds_;
+    }
+    double deviationError = 0, deviationClassification = 0;
+    for(int f = 0; f < numFolds_; f++){
+        deviationError = deviationError + pow(workers[f]->lowestError_ - meanError, 2)/(numFolds_-1);
+        deviationClassification = deviationClassification + pow(workers[f]->bestClassificationError_ - meanClassification, 2)/(numFolds_-1);
+    }
+    printf("mean validation error: %.6g (standard deviation %.6g)\n", meanError, sqrt(deviationError));
+    printf("mean classification error: %.2f%% (standard deviation %.2f%%)\n", 100*meanClassification, 100*sqrt(deviationClassification));
+    cout << "wall clock time: " << (endTime - startTime).total_milliseconds()/1000.0 << " seconds (loading " << (trainingTime - startTime).total_milliseconds()/1000.0 << " seconds, training " << (endTime - trainingTime).total_milliseconds()/1000.0 << " seconds)" << endl;
+}
+
+void NeuralNetwork::distributedTrainNeuralNetwork(){
+
+    //one process of a job started by hand on every machine with --rank
+    if(rank_ >= 0){
+        if(transportAddress_.empty()){
+            cout << "--rank needs the --transport address shared by all processes" << endl;
+            exit(1);
+        }
+        runDistributedWorker();
+        return;
+    }
+
+    if(scalingFlag_ == false){
+        launchDistributedWorkers(worldSize_);
+        return;
+    }
+
+    //strong scaling benchmark, the same data set and cycles trained by 1 to worldSize_ processes
+    printInfoFlag_ = false;
+    int maxProcesses = worldSize_;
+    std::vector<double> seconds;
+    for(int p = 1; p <= maxProcesses; p++){
+        seconds.push_back(launchDistributedWorkers(p));
+    }
+    printf("processes training_Seconds speedup efficiency\n");
+    for(int p = 1; p <= maxProcesses; p++){
+        double speedup = seconds[0]/seconds[p-1];
+        printf("%d %.3f %.2f %.1f%%\n", p, seconds[p-1], speedup, 100*speedup/p);
+    }
+}
+
+double NeuralNetwork::launchDistributedWorkers(int worldSize){
+
+    //without --transport every job gets its own socket, removed when the job ends
+    string socketPath;
+    if(transportAddress_.empty()){
+        char path[1024];
+        snprintf(path, sizeof(path), DEFAULTTRANSPORTPATH, (int)getpid());
+        socketPath = path;
+        transportAddress_ = "unix:" + socketPath;
+    }
+
+    //process 0 reports its training time back through a pipe
+    int timePipe[2];
+    if(pipe(timePipe) != 0){
+        cout << "cannot create pipe for distributed training" << endl;
+        exit(1);
+    }
+    cout.flush();
+    fflush(stdout);
+
+    std::vector<pid_t> workers;
+    for(int r = 0; r < worldSize; r++){
+        pid_t pid = fork();
+        if(pid < 0){
+            cout << "cannot start process " << r << " of distributed training" << endl;
+            exit(1);
+        }
+        if(pid == 0){
+            close(timePipe[0]);
+            rank_ = r;
+            worldSize_ = worldSize;
+            double seconds = runDistributedWorker();
+            if(rank_ == 0 && write(timePipe[1], &seconds, sizeof(double)) != sizeof(double))
+                _exit(1);
+            cout.flush();
+            fflush(stdout);
+            _exit(0);
+        }
+        workers.push_back(pid);
+    }
+    close(timePipe[1]);
+
+    //a process that fails takes the others down, they would wait for it forever
+    bool failed = false;
+    size_t running = workers.size();
+    while(running > 0){
+        for(size_t r = 0; r < workers.size(); r++){
+            int status = 0;
+            if(workers[r] == 0 || waitpid(workers[r], &status, WNOHANG) != workers[r])
+                continue;
+            workers[r] = 0;
+            running = running - 1;
+            if((!WIFEXITED(status) || WEXITSTATUS(status) != 0) && failed == false){
+                failed = true;
+                for(size_t k = 0; k < workers.size(); k++){
+                    if(workers[k] != 0)
+                        kill(workers[k], SIGKILL);
+                }
+            }
+        }
+        if(running > 0)
+            boost::this_thread::sleep(boost::posix_time::milliseconds(WORKERPOLLMS));
+    }
+
+    //every process has exited, so the pipe holds the time of process 0 unless it failed
+    double seconds = 0;
+    if(read(timePipe[0], &seconds, sizeof(double)) != sizeof(double))
+        failed = true;
+    close(timePipe[0]);
+    if(!socketPath.empty()){
+        unlink(socketPath.c_str());
+        transportAddress_.clear();
+    }
+    if(failed){
+        cout << "distributed training with " << worldSize << " processes failed" << endl;
+        exit(1);
+    }
+    return seconds;
+}
+
+double NeuralNetwork::runDistributedWorker(){
+
+    if(rank_ >= worldSize_){
+        cout << "rank must be smaller than the number of processes" << endl;
+        exit(1);
+    }
+    printInfoFlag_ = printInfoFlag_ && (rank_ == 0);
+
+    //every process keeps the samples s with s % worldSize_ == rank_, only process 0 validates
+    std::vector<int> labels = loadLabelSet(trainingDataFileLabel_, outputNodes_);
+    {
+        matrix<double> data = trans(loadDataSet(trainingDataFile_));
+        size_t numSamples = data.size2();
+        if(labels.size() != numSamples){
+            cout << "number of labels does not match the number of samples" << endl;
+            exit(1);
+        }
+        if(numSamples < (size_t)worldSize_){
+            cout << "every process needs at least one training sample" << endl;
+            exit(1);
+        }
+        size_t shardSamples = (numSamples - rank_ + worldSize_ - 1)/worldSize_;
+        trainingData_.reset(new matrix<double>(data.size1(), shardSamples));
+        trainingLabels_.reset(new std::vector<int>(shardSamples));
+        for(size_t k = 0; k < shardSamples; k++){
+            size_t s = rank_ + k*worldSize_;
+            for(size_t f = 0; f < data.size1(); f++){
+                (*trainingData_)(f,k) = data(f,s);
+            }
+            (*trainingLabels_)[k] = labels[s];
+        }
+        inputNodes_ = (data.size1())+1;
+    }
+    size_t maxShardSamples = (labels.size() + worldSize_ - 1)/worldSize_;
+    labels.clear();
+    if(rank_ == 0){
+        validationData_.reset(new matrix<double>(trans(loadDataSet(validationDataFile_))));
+        int validationClasses = 0;
+        validationLabels_.reset(new std::vector<int>(loadLabelSet(validationDataFileLabel_, validationClasses)));
+        if(validationLabels_->size() != validationData_->size2()){
+            cout << "number of labels does not match the number of samples" << endl;
+            exit(1);
+        }
+        if(validationClasses > outputNodes_){
+            cout << "validation labels have more classes than the training labels" << endl;
+            exit(1);
+        }
+        validationOrder_.resize(validationData_->size2());
+        for(size_t s = 0; s < validationOrder_.size(); s++){
+            validationOrder_[s] = s;
+        }
+    }
+
+    //process 0 accepts the connections once every process has loaded its shard
+    transport_.reset(createTransport(transportAddress_, rank_, worldSize_));
+    boost::posix_time::ptime startTime = boost::posix_time::microsec_clock::universal_time();
+
+    //all processes start from the random weights of process 0
+    initialiseWeights();
+    std::vector<double> weights;
+    packWeights(weights);
+    transport_->broadcast(weights);
+    unpackWeights(weights);
+
+    //the shard is trained in blocks of about syncInterval_ samples, every process has the same
+    //number of blocks so the averaging steps match up
+    if(syncInterval_ < 1)
+        syncInterval_ = 1;
+    size_t shardSamples = trainingData_->size2();
+    size_t numBlocks = (maxShardSamples + syncInterval_ - 1)/syncInterval_;
+    #ifdef NEURAL_NETWORK_PARAMETER_DEBUG_INFO
+        if(printInfoFlag_ == true)
+            cout << "distributed training on " << worldSize_ << " processes, " << shardSamples << " samples and " << numBlocks << " averaging steps per cycle on process 0" << endl;
+    #endif
+
+    for(int c = 0; c < numCycle_; c++){
+        if(rank_ == 0)
+            validateNeuralNetwork();
+
+        //only process 0 validates, so it decides the early stop and tells the others
+        if(patience_ > 0){
+            std::vector<double> stop(1, 0);
+            if(rank_ == 0 && cycle_ - bestIndex_ >= patience_){
+                stop[0] = 1;
+                if(printInfoFlag_ == true)
+                    cout << "validation error did not improve for " << patience_ << " cycles, training stopped at interation number: " << cycle_ << endl;
+            }
+            transport_->broadcast(stop);
+            if(stop[0] != 0)
+                break;
+        }
+        for(size_t b = 0; b < numBlocks; b++){
+            trainingOrder_.clear();
+            for(size_t s = b*shardSamples/numBlocks; s < (b+1)*shardSamples/numBlocks; s++){
+                trainingOrder_.push_back(s);
+            }
+            trainNeuralNetwork();
+            //the averaging of the previous block ran while this block was trained
+            finishWeightAveraging();
+            if(b+1 < numBlocks)
+                startWeightAveraging();
+        }
+        //every cycle ends with the same weights on all processes
+        packWeights(weights);
+        transport_->allReduceMean(weights);
+        unpackWeights(weights);
+        cycle_ = cycle_ + 1;
+    }//for(size_t c = 0; c < numCycle_; c++)
+
+    boost::posix_time::ptime endTime = boost::posix_time::microsec_clock::universal_time();
+    double seconds = (endTime - startTime).total_milliseconds()/1000.0;
+    if(rank_ == 0){
+        printTrainedModel();
+        saveTrainedModel();
+        if(traceFile_ != NULL)
+            fclose(traceFile_);
+        if(printInfoFlag_ == true)
+            cout << "training time on " << worldSize_ << " processes: " << seconds << " seconds" << endl;
+    }
+    transport_.reset();
+    return seconds;
+}
+
+void NeuralNetwork::packWeights(std::vector<double>& weights){
+    weights.resize(nnWeightBar_.size1()*nnWeightBar_.size2() + nnWeight_.size1()*nnWeight_.size2());
+    size_t k = 0;
+    for(size_t i = 0; i < nnWeightBar_.size1(); i++){
+        for(size_t j = 0; j < nnWeightBar_.size2(); j++){
+            weights[k++] = nnWeightBar_(i,j);
+        }
+    }
+    for(size_t i = 0; i < nnWeight_.size1(); i++){
+        for(size_t j = 0; j < nnWeight_.size2(); j++){
+            weights[k++] = nnWeight_(i,j);
+        }
+    }
+}
+
+void NeuralNetwork::unpackWeights(const std::vector<double>& weights){
+    size_t k = 0;
+    for(size_t i = 0; i < nnWeightBar_.size1(); i++){
+        for(size_t j = 0; j < nnWeightBar_.size2(); j++){
+            nnWeightBar_(i,j) = weights[k++];
+        }
+    }
+    for(size_t i = 0; i < nnWeight_.size1(); i++){
+        for(size_t j = 0; j < nnWeight_.size2(); j++){
+            nnWeight_(i,j) = weights[k++];
+        }
+    }
+}
+
+void NeuralNetwork::startWeightAveraging(){
+    packWeights(sentWeights_);
+    averagedWeights_ = sentWeights_;
+    averagingThread_ = boost::thread(boost::bind(&Transport::allReduceMean, transport_.get(), boost::ref(averagedWeights_)));
+}
+
+void NeuralNetwork::finishWeightAveraging(){
+
+    if(!averagingThread_.joinable())
+        return;
+    averagingThread_.join();
+
+    //the weights were trained further while the snapshot was averaged, that progress is kept
+    size_t k = 0;
+    for(size_t i = 0; i < nnWeightBar_.size1(); i++){
+        for(size_t j = 0; j < nnWeightBar_.size2(); j++){
+            nnWeightBar_(i,j) = nnWeightBar_(i,j) + averagedWeights_[k] - sentWeights_[k];
+            k++;
+        }
+    }
+    for(size_t i = 0; i < nnWeight_.size1(); i++){
+        for(size_t j = 0; j < nnWeight_.size2(); j++){
+            nnWeight_(i,j) = nnWeight_(i,j) + averagedWeights_[k] - sentWeights_[k];
+            k++;
+        }
+    }
+}
+
+void NeuralNetwork::initialiseWeights(){
+
+    if(initModelFile_ != NULL){
+        initialiseWeightsFromModel();
+        return;
+    }
+
     if(hiddenNodeDefaultFlag_ == 0){
         double temp = (pow(outputNodes_,2.0) + outputNodes_+ 2)/2;
         hiddenNodes_ = ceil(log2(temp)) + 1;
     }
     #ifdef NEURAL_NETWORK_PARAMETER_DEBUG_INFO
-        cout << "Neural Network input nodes: " << inputNodes_ << " hidden nodes: " << hiddenNodes_ << " output nodes: " << outputNodes_ << endl;
+        if(printInfoFlag_ == true)
+            cout << "Neural Network input nodes: " << inputNodes_ << " hidden nodes: " << hiddenNodes_ << " output nodes: " << outputNodes_ << endl;
     #endif
 
     nnWeight_ = zero_matrix<double>(outputNodes_,hiddenNodes_);
@@ -101,14 +786,52 @@ void NeuralNetwork::trainValidateNeuralNetwork(){
     }
 
     #ifdef NEURAL_NETWORK_PARAMETER_DEBUG_INFO
-        cout << "size of weights matrix from input nodes to hidden nodes: " << nnWeightBar_.size1() << " rows and " << nnWeightBar_.size2() << " columns" << endl;
-        cout << "size of weights matrix from hidden nodes to output nodes: " << nnWeight_.size1() << " rows and " << nnWeight_.size2() << " columns" << endl;
+        if(printInfoFlag_ == true){
+            cout << "size of weights matrix from input nodes to hidden nodes: " << nnWeightBar_.size1() << " rows and " << nnWeightBar_.size2() << " columns" << endl;
+            cout << "size of weights matrix from hidden nodes to output nodes: " << nnWeight_.size1() << " rows and " << nnWeight_.size2() << " columns" << endl;
+        }
     #endif
+}
 
-    for(size_t c = 0; c < numCycle_; c++){
-        validateNeuralNetwork(); // validate the neural network with validation data
-        trainNeuralNetwork();    // train the neural network with training data
-    }//for(size_t c = 0; c < numCycle_; c++)
+void NeuralNetwork::initialiseWeightsFromModel(){
+
+    //the model has to fit the training data, the learning rate and cycles of this run are kept
+    int dataInputNodes = inputNodes_;
+    int dataOutputNodes = outputNodes_;
+    int hiddenNodes = hiddenNodes_;
+    double learnRate = learnRate_;
+    int numCycle = numCycle_;
+    loadTrainedModel(initModelFile_);
+    learnRate_ = learnRate;
+    numCycle_ = numCycle;
+    if(inputNodes_ != dataInputNodes){
+        cout << "the --init-model has " << inputNodes_-1 << " input features but the training data has " << dataInputNodes-1 << endl;
+        exit(1);
+    }
+    //labels of a refresh may not use every class of the model, but cannot add classes
+    if(outputNodes_ < dataOutputNodes){
+        cout << "the --init-model has " << outputNodes_ << " output nodes but the training labels have " << dataOutputNodes << " classes" << endl;
+        exit(1);
+    }
+    if(hiddenNodeDefaultFlag_ == 1 && hiddenNodes_ != hiddenNodes){
+        cout << "the --init-model has " << hiddenNodes_ << " hidden nodes, -h " << hiddenNodes << " does not match" << endl;
+        exit(1);
+    }
+
+    //pruned models continue training as dense models
+    nnWeightBar_ = wbarBest_;
+    nnWeight_ = wBest_;
+    sparseWbar_ = SparseLayer();
+    eValidation_ = zero_matrix<double>(1,numCycle_);
+    cyclicError_ = zero_matrix<double>(1,numCycle_);
+
+    #ifdef NEURAL_NETWORK_PARAMETER_DEBUG_INFO
+        if(printInfoFlag_ == true)
+            cout << "Neural Network input nodes: " << inputNodes_ << " hidden nodes: " << hiddenNodes_ << " output nodes: " << outputNodes_ << " initialised from " << initModelFile_ << endl;
+    #endif
+}
+
+void NeuralNetwork::printTrainedModel(){
 
     if(verbose_ == true){
         cout << "Trained Neural Network Information with one hidden layer" << endl;
@@ -121,37 +844,36 @@ void NeuralNetwork::trainValidateNeuralNetwork(){
         cout << "Optimised Weights from input to hidden nodes: " << wbarBest_ << endl;
         cout << "Optimised Weights from hidden to output nodes: " << wBest_ << endl;
     }
-    saveTrainedModel();
-    //cout << "Neural network trained and model parameters saved in file named " << modelFile_ << endl;
 }
 
-
-
-
 void NeuralNetwork::validateNeuralNetwork(){
+    validationMistakes_ = 0;
+    eValidation_(0,cycle_) = validationError()/validationOrder_.size();
+    classificationError_ = (double)validationMistakes_/validationOrder_.size();
+    updateBestWeights();
+}
+
+double NeuralNetwork::validationError(){
 
     //define vbar and preceptron matrices
     matrix<double> validationDataColumn(inputNodes_,1);
-    matrix<double> validationLabelsColumn(outputNodes_,1);
     matrix<double> vbar(hiddenNodes_-1,1);
     matrix<double> v(outputNodes_,1);
     matrix<double> Y(hiddenNodes_,1);
     matrix<double> Z(outputNodes_,1);
+    double error = 0;
 
     //Validation Cycle
-    for(size_t a = 0; a < validationData_.size2(); a++){
-
-        for(size_t temp = 0; temp < validationLabels_.size1(); temp++){
-            validationLabelsColumn(temp,0) = validationLabels_(temp,a);
-        }
+    for(size_t o = 0; o < validationOrder_.size(); o++){
+        size_t a = validationOrder_[o];
 
-        for(size_t temp = 0; temp < validationData_.size1(); temp++){
-            validationDataColumn(temp,0) = validationData_(temp,a);
+        for(size_t temp = 0; temp < validationData_->size1(); temp++){
+            validationDataColumn(temp,0) = (*validationData_)(temp,a);
         }
         validationDataColumn((inputNodes_)-1,0) = -1;
         #ifdef NEURAL_NETWORK_VALIDATION_DEBUG_INFO
             cout << "validation data: " << validationDataColumn << endl;
-            cout << "validation Label column: " << validationLabelsColumn << endl;
+            cout << "validation Label: " << (*validationLabels_)[a]+1 << endl;
         #endif
 
         vbar = prod(nnWeightBar_,validationDataColumn);
@@ -178,18 +900,28 @@ void NeuralNetwork::validateNeuralNetwork(){
             cout << "perceptron values at the output layer: " << Z << endl;
         #endif
 
-        //validation error
+        //validation error, the target is +1 for the labelled class and -1 for the others
         double temp = 0;
+        int predicted = 0;
         for(size_t i = 0; i < Z.size1();i++){
-            temp = temp + 0.5*pow((validationLabelsColumn(i,0) - Z(i,0)),2);
+            double target = ((int)i == (*validationLabels_)[a]) ? 1 : -1;
+            temp = temp + 0.5*pow((target - Z(i,0)),2);
+            if(Z(i,0) > Z(predicted,0))
+                predicted = i;
         }
+        if(predicted != (*validationLabels_)[a])
+            validationMistakes_ = validationMistakes_ + 1;
 
         #ifdef NEURAL_NETWORK_VALIDATION_DEBUG_INFO
             cout << "Validation Error " << temp << endl;
         #endif
-        eValidation_(0,cycle_) = temp;
+        error = error + temp;
 
-    }//for(size_t a = 0; a < validationData_.size1(); a++)
+    }//for(size_t o = 0; o < validationOrder_.size(); o++)
+    return error;
+}
+
+void NeuralNetwork::updateBestWeights(){
 
     //save best weights
     if(eValidation_(0,cycle_) < lowestError_){
@@ -197,11 +929,16 @@ void NeuralNetwork::validateNeuralNetwork(){
         wbarBest_ = nnWeightBar_;
         bestIndex_ = cycle_;
         lowestError_ = eValidation_(0,cycle_);
+        bestClassificationError_ = classificationError_;
     }
+    if(traceFileName_ != NULL)
+        writeTrace();
 
     #ifdef NEURAL_NETWORK_TRAINING_UPDATE_DEBUG_INFO
-        cout << "Interation cycle number: " << cycle_ << endl;
-        cout << "Neural network optimised at interation number: " << bestIndex_ << endl;
+        if(printInfoFlag_ == true){
+            cout << "Interation cycle number: " << cycle_ << endl;
+            cout << "Neural network optimised at interation number: " << bestIndex_ << endl;
+        }
     #endif
 
     #ifdef NEURAL_NETWORK_VALIDATION_DEBUG_INFO
@@ -212,33 +949,33 @@ void NeuralNetwork::validateNeuralNetwork(){
 
 void NeuralNetwork::trainNeuralNetwork(){
 
+    if(hogwildThreads_ > 0){
+        trainNeuralNetworkHogwild();
+        return;
+    }
+
     //vbar and preceptron and back propogation matrices.
     matrix<double> vbar(hiddenNodes_-1,1);
     matrix<double> v(outputNodes_,1);
     matrix<double> Y(hiddenNodes_,1);
     matrix<double> Z(outputNodes_,1);
     matrix<double> trainingDataColumn(inputNodes_,1);
-    matrix<double> trainingLabelsColumn(outputNodes_,1);
     matrix<double> delta(outputNodes_,1);
     matrix<double> deltaBar(hiddenNodes_-1,1);
     matrix<double> deltaBar1(hiddenNodes_-1,1);
     matrix<double> deltaBar2(hiddenNodes_-1,1);
-    matrix<double> sampleError(1,numCycle_*trainingData_.size2());
 
-    for(size_t s = 0; s < trainingData_.size2(); s++){
-
-        for(size_t temp = 0; temp < trainingLabels_.size1();temp++){
-            trainingLabelsColumn(temp,0) = trainingLabels_(temp,s);
-        }
+    for(size_t o = 0; o < trainingOrder_.size(); o++){
+        size_t s = trainingOrder_[o];
 
-        for(size_t temp = 0; temp < trainingData_.size1();temp++){
-            trainingDataColumn(temp,0) = trainingData_(temp,s);
+        for(size_t temp = 0; temp < trainingData_->size1();temp++){
+            trainingDataColumn(temp,0) = (*trainingData_)(temp,s);
         }
         trainingDataColumn((inputNodes_)-1,0) = -1;
 
         #ifdef NEURAL_NETWORK_TRAINING_DEBUG_INFO
             cout << "training data: " << trainingDataColumn << endl;
-            cout << "training Label column: " << trainingLabelsColumn << endl;
+            cout << "training Label: " << (*trainingLabels_)[s]+1 << endl;
         #endif
 
         vbar = prod(nnWeightBar_,trainingDataColumn);
@@ -262,9 +999,10 @@ void NeuralNetwork::trainNeuralNetwork(){
             cout << "perceptron values at the output layer: " << Z << endl;
         #endif
 
-        //calculate delta back propagation
+        //calculate delta back propagation, the target is +1 for the labelled class and -1 for the others
         for(size_t temp = 0; temp < Z.size1();temp++){
-            delta(temp,0) = (trainingLabelsColumn(temp,0) - Z(temp,0))*(0.5*(1-pow(Z(temp,0),2)));
+            double target = ((int)temp == (*trainingLabels_)[s]) ? 1 : -1;
+            delta(temp,0) = (target - Z(temp,0))*(0.5*(1-pow(Z(temp,0),2)));
         }
 
         for(size_t temp = 0; temp < Y.size1()-1;temp++){
@@ -317,6 +1055,9 @@ void NeuralNetwork::trainNeuralNetwork(){
             }
         }
 
+        //pruned blocks of a model being fine tuned stay at zero
+        if(pruneMask_.size1() > 0)
+            dwBar = element_prod(dwBar, pruneMask_);
         nnWeightBar_ = nnWeightBar_ + learnRate_*(dwBar);
 
         #ifdef NEURAL_NETWORK_TRAINING_DEBUG_INFO
@@ -326,98 +1067,349 @@ void NeuralNetwork::trainNeuralNetwork(){
 
         //error for every sample
         double temp = 0;
-        for(size_t i = 0; i < trainingLabelsColumn.size1();i++){
-            temp = temp + 0.5*pow((trainingLabelsColumn(i,0) - Z(i,0)),2);
+        for(size_t i = 0; i < Z.size1();i++){
+            double target = ((int)i == (*trainingLabels_)[s]) ? 1 : -1;
+            temp = temp + 0.5*pow((target - Z(i,0)),2);
         }
-        sampleError(0,step_) = temp;
+        cyclicError_(0,cycle_) = cyclicError_(0,cycle_) + temp;
         step_ = step_ + 1;
         #ifdef NEURAL_NETWORK_TRAINING_DEBUG_INFO
             cout << "training error between predicted and actual label: " << temp << endl;
         #endif
 
-    }//for(size_t s = 0; s < trainingData_.size1(); s++)
+    }//for(size_t o = 0; o < trainingOrder_.size(); o++)
+}
+
+void NeuralNetwork::trainNeuralNetworkHogwild(){
 
-    //training error
-    for(size_t i = step_ - trainingData_.size1()-1; i < step_-1 ;i++){
-        cyclicError_(0,cycle_) = cyclicError_(0,cycle_) + sampleError(0,i);
+    //threads take the next sample from a shared cursor and update the weights in place without
+    //locks; they are joined before the next validation, so validation sees a consistent snapshot
+    boost::atomic<size_t> cursor(0);
+    std::vector<double> errors(hogwildThreads_, 0);
+    boost::thread_group pool;
+    for(int t = 0; t < hogwildThreads_; t++){
+        pool.create_thread(boost::bind(&NeuralNetwork::hogwildWorker, this, &cursor, &errors[t]));
     }
-    cycle_ = cycle_ + 1;
+    pool.join_all();
+
+    for(int t = 0; t < hogwildThreads_; t++){
+        cyclicError_(0,cycle_) = cyclicError_(0,cycle_) + errors[t];
+    }
+    step_ = step_ + trainingOrder_.size();
 }
 
-void NeuralNetwork::testNeuralNetwork(){
+void NeuralNetwork::hogwildWorker(boost::atomic<size_t>* cursor, double* error){
+
+    //same forward and back propagation as trainNeuralNetwork() on thread local activations,
+    //ublas assignments would reallocate the shared weights so they are updated element by element
+    int hidden = hiddenNodes_-1;
+    std::vector<double> x(inputNodes_);
+    std::vector<double> Y(hiddenNodes_);
+    std::vector<double> Z(outputNodes_);
+    std::vector<double> delta(outputNodes_);
+    std::vector<double> deltaBar(hidden);
+    double* wbar = &nnWeightBar_.data()[0];
+    double* w = &nnWeight_.data()[0];
+    const double* mask = (pruneMask_.size1() > 0) ? &pruneMask_.data()[0] : NULL;
+
+    //the error is summed locally, the error slots of the threads share a cache line
+    double sampleErrors = 0;
+
+    while(true){
+        size_t o = cursor->fetch_add(1, boost::memory_order_relaxed);
+        if(o >= trainingOrder_.size())
+            break;
+        size_t s = trainingOrder_[o];
+        int label = (*trainingLabels_)[s];
 
-    testingData_ = loadDataSet(testingDataFile_);
-    testingData_ = trans(testingData_);
-    testingLabels_ = loadDataSet(testingDataFileLabel_);
-    testingLabels_ = trans(testingLabels_);
+        for(size_t j = 0; j < trainingData_->size1(); j++){
+            x[j] = (*trainingData_)(j,s);
+        }
+        x[inputNodes_-1] = -1;
 
-    #ifdef NEURAL_NETWORK_TESTING_DEBUG_INFO
-        cout << "Testing data size: " << testingData_.size1() << " " << testingData_.size2() << endl;
-        cout << "Testing label size: " << testingLabels_.size1() << " " << testingLabels_.size2() << endl;
-    #endif
+        for(int i = 0; i < hidden; i++){
+            double sum = 0;
+            for(int j = 0; j < inputNodes_; j++){
+                sum = sum + wbar[i*inputNodes_+j]*x[j];
+            }
+            Y[i] = (1 - exp(-sum))/(1+exp(-sum));
+        }
+        Y[hidden] = -1;
 
-    matrix<double> testingDataColumn(inputNodes_,1);
-    matrix<double> testingLabelsColumn(outputNodes_,1);
-    matrix<double> vbar(hiddenNodes_-1,1);
-    matrix<double> v(outputNodes_,1);
-    matrix<double> Y(hiddenNodes_,1);
-    matrix<double> Z(outputNodes_,1);
+        for(int i = 0; i < outputNodes_; i++){
+            double sum = 0;
+            for(int j = 0; j < hiddenNodes_; j++){
+                sum = sum + w[i*hiddenNodes_+j]*Y[j];
+            }
+            Z[i] = (1 - exp(-sum))/(1+exp(-sum));
+        }
 
-    for(size_t a = 0; a < testingData_.size2(); a++){
+        for(int i = 0; i < outputNodes_; i++){
+            double target = ((int)i == label) ? 1 : -1;
+            delta[i] = (target - Z[i])*(0.5*(1-pow(Z[i],2)));
+            sampleErrors = sampleErrors + 0.5*pow((target - Z[i]),2);
+        }
 
-        for(size_t temp = 0; temp < testingLabels_.size1(); temp++){
-            testingLabelsColumn(temp,0) = testingLabels_(temp,a);
+        for(int i = 0; i < hidden; i++){
+            double sum = 0;
+            for(int j = 0; j < outputNodes_; j++){
+                sum = sum + delta[j]*w[j*hiddenNodes_+i];
+            }
+            deltaBar[i] = 0.5*(1-pow(Y[i],2))*sum;
         }
 
-        for(size_t temp = 0; temp < testingData_.size1(); temp++){
-            testingDataColumn(temp,0) = testingData_(temp,a);
+        for(int i = 0; i < outputNodes_; i++){
+            double tmp = learnRate_*delta[i];
+            for(int j = 0; j < hiddenNodes_; j++){
+                w[i*hiddenNodes_+j] = w[i*hiddenNodes_+j] + tmp*Y[j];
+            }
+        }
+        for(int i = 0; i < hidden; i++){
+            double tmp = learnRate_*deltaBar[i];
+            if(mask != NULL){
+                for(int j = 0; j < inputNodes_; j++){
+                    wbar[i*inputNodes_+j] = wbar[i*inputNodes_+j] + tmp*x[j]*mask[i*inputNodes_+j];
+                }
+            }else{
+                for(int j = 0; j < inputNodes_; j++){
+                    wbar[i*inputNodes_+j] = wbar[i*inputNodes_+j] + tmp*x[j];
+                }
+            }
         }
-        testingDataColumn((inputNodes_)-1,0) = -1;
-        /*#ifdef NEURAL_NETWORK_TESTING_DEBUG_INFO
-            cout << "Testing data: " << testingDataColumn << endl;
-            cout << "testing label: " << testingLabelsColumn << endl;
-        #endif*/
+    }//while(true)
+    *error = sampleErrors;
+}
 
-        vbar = prod(wbarBest_,testingDataColumn);
+void NeuralNetwork::writeTrace(){
 
-        for(size_t temp = 0; temp < vbar.size1();temp++){
-            Y(temp,0) = (1 - exp(-vbar(temp,0)))/(1+exp(-vbar(temp,0)));
+    if(traceFile_ == NULL){
+        traceFile_ = fopen(traceFileName_,"w");
+        if(traceFile_ == NULL){
+            cout << "cannot write n the file" << endl;
+            exit(1);
         }
+        traceStartTime_ = boost::posix_time::microsec_clock::universal_time();
+        fprintf(traceFile_,"cycle wall_Seconds validation_Error classification_Error\n");
+    }
+    boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+    fprintf(traceFile_,"%d %.3f %.6g %.4f\n", cycle_, (now - traceStartTime_).total_microseconds()/1e6, eValidation_(0,cycle_), classificationError_);
+    fflush(traceFile_);
+}
 
-        /*#ifdef NEURAL_NETWORK_TRAINING_DEBUG_INFO
-            cout << "Values before multiplying with the bipolar logistic function(BLF) at the hidden layer: " << vbar << endl;
-            cout << "perceptron values at the hidden layer: " << Y << endl;
-        #endif*/
+void NeuralNetwork::pruneNeuralNetwork(){
+
+    std::vector<double> sparsities = parseList(pruneList_, 0);
+    matrix<double> denseWbar = wbarBest_;
+    matrix<double> denseW = wBest_;
+    char* denseModelFile = modelFile_;
+    int denseCycles = numCycle_;
+    printInfoFlag_ = false;
+    traceFileName_ = NULL;
+
+    //validation samples with the bias input, padded to whole blocks for the sparse kernel
+    size_t padded = (inputNodes_ + SPARSEBLOCKSIZE - 1)/SPARSEBLOCKSIZE*SPARSEBLOCKSIZE;
+    size_t numSamples = validationOrder_.size();
+    std::vector<double> inputs(numSamples*padded, 0);
+    std::vector<int> labels(numSamples);
+    for(size_t s = 0; s < numSamples; s++){
+        for(size_t f = 0; f < validationData_->size1(); f++){
+            inputs[s*padded+f] = (*validationData_)(f,validationOrder_[s]);
+        }
+        inputs[s*padded+inputNodes_-1] = -1;
+        labels[s] = (*validationLabels_)[validationOrder_[s]];
+    }
 
-        Y(Y.size1()-1,0) = -1;
-        v = prod(wBest_,Y);
-        for(size_t temp = 0; temp < v.size1();temp++){
-            Z(temp,0) = (1 - exp(-v(temp,0)))/(1+exp(-v(temp,0)));
+    //the dense model is the reference for speed and accuracy
+    std::vector<double> blockDensity(1, 1.0);
+    std::vector<double> validationErrors(1, lowestError_);
+    std::vector<double> classificationErrors(1, 0);
+    std::vector<double> microseconds(1, 0);
+    std::vector<string> modelFiles(1, modelFile_);
+    sparseWbar_ = SparseLayer();
+    microseconds[0] = inferenceMicroseconds(inputs, labels, classificationErrors[0]);
+
+    for(size_t k = 0; k < sparsities.size(); k++){
+        if(sparsities[k] < 0 || sparsities[k] >= 1){
+            cout << "pruning sparsities must be at least 0 and below 1" << endl;
+            exit(1);
         }
 
-        /*#ifdef NEURAL_NETWORK_TRAINING_DEBUG_INFO
-            cout << "Values before multiplying with the bipolar logistic function(BLF) at the hidden layer: " << v << endl;
-            cout << "perceptron values at the hidden layer: " << Z << endl;
-        #endif*/
+        //the smallest blocks are removed and the rest is fine tuned, the weight updates are masked
+        //so the pruned blocks stay at zero; cycle 0 validates the pruned weights before any fine tuning
+        pruneBlocks(denseWbar, sparsities[k], pruneMask_);
+        nnWeightBar_ = denseWbar;
+        nnWeight_ = denseW;
+        applyPruneMask();
+        eValidation_ = zero_matrix<double>(1,pruneCycles_+1);
+        cyclicError_ = zero_matrix<double>(1,pruneCycles_+1);
+        lowestError_ = DBL_MAX;
+        cycle_ = 0;
+        for(int c = 0; c <= pruneCycles_; c++){
+            validateNeuralNetwork();
+            if(c < pruneCycles_)
+                trainNeuralNetwork();
+            cycle_ = cycle_ + 1;
+        }
+
+        sparseWbar_.compress(wbarBest_);
+        double classificationError = 0;
+        double time = inferenceMicroseconds(inputs, labels, classificationError);
+
+        char name[1024];
+        snprintf(name, sizeof(name), "%s.s%g", denseModelFile, sparsities[k]);
+        modelFiles.push_back(name);
+        modelFile_ = &modelFiles.back()[0];
+        //the header of a pruned model describes its fine tuning, the best index counts fine tune cycles
+        numCycle_ = pruneCycles_;
+        saveTrainedModel();
+
+        blockDensity.push_back((double)sparseWbar_.numBlocks()/(sparseWbar_.rows_*sparseWbar_.paddedCols_/SPARSEBLOCKSIZE));
+        validationErrors.push_back(lowestError_);
+        classificationErrors.push_back(classificationError);
+        microseconds.push_back(time);
+    }
+    modelFile_ = denseModelFile;
+    numCycle_ = denseCycles;
+    pruneMask_.resize(0, 0, false);
+
+    printf("sparsity block_Density validation_Error classification_Error accuracy_Loss microseconds_per_sample speedup model_File\n");
+    for(size_t k = 0; k < modelFiles.size(); k++){
+        double sparsity = (k == 0) ? 0 : sparsities[k-1];
+        printf("%g %.3f %.6g %.2f%% %.2f%% %.3f %.2f %s\n", sparsity, blockDensity[k], validationErrors[k], 100*classificationErrors[k], 100*(classificationErrors[k] - classificationErrors[0]), microseconds[k], microseconds[0]/microseconds[k], modelFiles[k].c_str());
+    }
+}
+
+void NeuralNetwork::pruneBlocks(const matrix<double>& weights, double sparsity, matrix<double>& mask){
 
-        //extracting the actual label of the data from label file
-        int maxVal = -100;
-        int maxValIndex = 0;
-        for(size_t temp = 0; temp < testingLabels_.size1(); temp++){
-            testingLabelsColumn(temp,0) = testingLabels_(temp,a);
-            if(testingLabelsColumn(temp,0) > maxVal){
-                maxVal = testingLabelsColumn(temp,0);
-                maxValIndex = temp+1;
+    //magnitude of every 1xSPARSEBLOCKSIZE block, the blocks with the smallest magnitudes are zeroed
+    std::vector<std::pair<double,size_t> > blocks;
+    size_t blocksPerRow = (weights.size2() + SPARSEBLOCKSIZE - 1)/SPARSEBLOCKSIZE;
+    for(size_t i = 0; i < weights.size1(); i++){
+        for(size_t b = 0; b < blocksPerRow; b++){
+            double magnitude = 0;
+            for(size_t j = b*SPARSEBLOCKSIZE; j < (b+1)*SPARSEBLOCKSIZE && j < weights.size2(); j++){
+                magnitude = magnitude + fabs(weights(i,j));
             }
+            blocks.push_back(std::make_pair(magnitude, i*blocksPerRow + b));
+        }
+    }
+    std::sort(blocks.begin(), blocks.end());
+
+    mask = scalar_matrix<double>(weights.size1(), weights.size2(), 1);
+    size_t pruned = (size_t)(sparsity*blocks.size());
+    for(size_t k = 0; k < pruned; k++){
+        size_t i = blocks[k].second/blocksPerRow;
+        size_t b = blocks[k].second%blocksPerRow;
+        for(size_t j = b*SPARSEBLOCKSIZE; j < (b+1)*SPARSEBLOCKSIZE && j < weights.size2(); j++){
+            mask(i,j) = 0;
+        }
+    }
+}
+
+void NeuralNetwork::applyPruneMask(){
+    nnWeightBar_ = element_prod(nnWeightBar_, pruneMask_);
+}
+
+void NeuralNetwork::forwardBest(const double* x, double* Y, double* Z){
+
+    //x holds the inputs with the bias, padded with zeros to whole blocks for pruned models
+    if(sparseWbar_.rows_ > 0)
+        sparseWbar_.multiply(x, Y);
+    else
+        SparseLayer::multiplyDense(wbarBest_, x, Y);
+    for(int i = 0; i < hiddenNodes_-1; i++){
+        Y[i] = (1 - exp(-Y[i]))/(1+exp(-Y[i]));
+    }
+    Y[hiddenNodes_-1] = -1;
+
+    SparseLayer::multiplyDense(wBest_, Y, Z);
+    for(int i = 0; i < outputNodes_; i++){
+        Z[i] = (1 - exp(-Z[i]))/(1+exp(-Z[i]));
+    }
+}
+
+double NeuralNetwork::inferenceMicroseconds(const std::vector<double>& inputs, const std::vector<int>& labels, double& classificationError){
+
+    size_t padded = inputs.size()/labels.size();
+    std::vector<double> Y(hiddenNodes_);
+    std::vector<double> Z(outputNodes_);
+
+    //classification error of the kernel used for inference
+    int mistakes = 0;
+    for(size_t s = 0; s < labels.size(); s++){
+        forwardBest(&inputs[s*padded], &Y[0], &Z[0]);
+        int predicted = 0;
+        for(int i = 1; i < outputNodes_; i++){
+            if(Z[i] > Z[predicted])
+                predicted = i;
+        }
+        if(predicted != labels[s])
+            mistakes = mistakes + 1;
+    }
+    classificationError = (double)mistakes/labels.size();
+
+    //the validation set is run repeatedly for at least PRUNETIMINGSECONDS
+    boost::posix_time::ptime startTime = boost::posix_time::microsec_clock::universal_time();
+    double elapsed = 0;
+    size_t repetitions = 0;
+    while(elapsed < PRUNETIMINGSECONDS*1e6){
+        for(size_t s = 0; s < labels.size(); s++){
+            forwardBest(&inputs[s*padded], &Y[0], &Z[0]);
+        }
+        repetitions = repetitions + 1;
+        elapsed = (boost::posix_time::microsec_clock::universal_time() - startTime).total_microseconds();
+    }
+    return elapsed/(repetitions*labels.size());
+}
+
+void NeuralNetwork::testNeuralNetwork(){
+
+    testingData_ = loadDataSet(testingDataFile_);
+    testingData_ = trans(testingData_);
+    int testingClasses = 0;
+    testingLabels_ = loadLabelSet(testingDataFileLabel_, testingClasses);
+    if(testingLabels_.size() != testingData_.size2()){
+        cout << "number of labels does not match the number of samples" << endl;
+        exit(1);
+    }
+    if((int)testingData_.size1() != inputNodes_-1){
+        cout << "testing data has " << testingData_.size1() << " features but the model expects " << inputNodes_-1 << endl;
+        exit(1);
+    }
+
+    #ifdef NEURAL_NETWORK_PARAMETER_DEBUG_INFO
+        if(featureExtractionFlag_ == true)
+            featureExtraction_.printRealTimeFactor();
+        cout << "testing labels: " << testingLabels_.size() << " samples, " << testingLabels_.size()*sizeof(int) << " bytes (one-hot double matrix: " << testingLabels_.size()*testingClasses*sizeof(double) << " bytes)" << endl;
+    #endif
+
+    #ifdef NEURAL_NETWORK_TESTING_DEBUG_INFO
+        cout << "Testing data size: " << testingData_.size1() << " " << testingData_.size2() << endl;
+        cout << "Testing label size: " << testingLabels_.size() << endl;
+    #endif
+
+    //inputs padded to whole blocks for the sparse kernel of pruned models
+    std::vector<double> x((inputNodes_ + SPARSEBLOCKSIZE - 1)/SPARSEBLOCKSIZE*SPARSEBLOCKSIZE, 0);
+    std::vector<double> Y(hiddenNodes_);
+    std::vector<double> Z(outputNodes_);
+
+    for(size_t a = 0; a < testingData_.size2(); a++){
 
+        for(size_t temp = 0; temp < testingData_.size1(); temp++){
+            x[temp] = testingData_(temp,a);
         }
+        x[inputNodes_-1] = -1;
+        forwardBest(&x[0], &Y[0], &Z[0]);
+
+        //actual label of the data sample
+        int maxValIndex = testingLabels_[a]+1;
 
         //extracting the predicted label of the data sample done by the neural network
         float maxVal1 = -100.00;
         int maxValIndexP = 0;
-        for(size_t temp = 0; temp < Z.size1();temp++){
-            if(Z(temp,0) > maxVal1){
-                maxVal1 = Z(temp,0);
+        for(int temp = 0; temp < outputNodes_;temp++){
+            if(Z[temp] > maxVal1){
+                maxVal1 = Z[temp];
                 maxValIndexP = temp+1;
             }
         }
@@ -437,8 +1429,149 @@ void NeuralNetwork::testNeuralNetwork(){
 
 }
 
+void NeuralNetwork::computePosteriors(const double* x, double* Y, double* posteriors){
+
+    forwardBest(x, Y, posteriors);
+
+    //the bipolar outputs are mapped to [0,1] and normalised to sum to one
+    double sum = 0;
+    for(int temp = 0; temp < outputNodes_; temp++){
+        posteriors[temp] = 0.5*(1 + posteriors[temp]);
+        sum = sum + posteriors[temp];
+    }
+    for(int temp = 0; temp < outputNodes_; temp++){
+        posteriors[temp] = posteriors[temp]/sum;
+    }
+}
+
+void NeuralNetwork::decodeNeuralNetwork(){
+
+    viterbiDecoder_.loadLexicon(lexiconFile_);
+    viterbiDecoder_.startDecoding(outputNodes_);
+
+    //frames are decoded as they are read, so memory does not grow with the utterance
+    std::vector<double> x((inputNodes_ + SPARSEBLOCKSIZE - 1)/SPARSEBLOCKSIZE*SPARSEBLOCKSIZE, 0);
+    std::vector<double> Y(hiddenNodes_);
+    std::vector<double> posteriors(outputNodes_);
+    int features = inputNodes_-1;
+
+    if(isWavList(decodingDataFile_)){
+        matrix<double> decodingData = loadDataSet(decodingDataFile_);
+        if((int)decodingData.size2() != features){
+            cout << "decoding data has " << decodingData.size2() << " features but the model expects " << features << endl;
+            exit(1);
+        }
+        for(size_t t = 0; t < decodingData.size1(); t++){
+            for(int f = 0; f < features; f++){
+                x[f] = decodingData(t,f);
+            }
+            x[features] = -1;
+            computePosteriors(&x[0], &Y[0], &posteriors[0]);
+            viterbiDecoder_.decodeFrame(&posteriors[0]);
+        }
+    }else{
+        ifstream infile;
+        infile.open(decodingDataFile_);
+        if(!infile.is_open()){
+            cout << "Failed to open file" << endl;
+            exit(1);
+        }
+        string line;
+        while(getline(infile, line)){
+            if(line.find_first_not_of(" \t\r") == string::npos)
+                continue;
+            stringstream stream(line);
+            int cols = 0;
+            double value;
+            while(stream >> value){
+                if(cols < features)
+                    x[cols] = value;
+                cols++;
+            }
+            if(cols != features){
+                cout << "decoding data has " << cols << " features but the model expects " << features << endl;
+                exit(1);
+            }
+            x[features] = -1;
+            computePosteriors(&x[0], &Y[0], &posteriors[0]);
+            viterbiDecoder_.decodeFrame(&posteriors[0]);
+        }
+        infile.close();
+    }
+
+    viterbiDecoder_.finishDecoding();
+    viterbiDecoder_.printResult();
+    viterbiDecoder_.printDecodingSpeed();
+}
+
+bool NeuralNetwork::isWavList(char* fileName){
+    size_t length = strlen(fileName);
+    return length > 4 && strcmp(fileName+length-4,".scp") == 0;
+}
+
+void NeuralNetwork::extractFeatures(){
+
+    matrix<double> features = featureExtraction_.extractFeatureList(wavListFile_, featureFrames_);
+
+    FILE *fp = fopen(featureFile_,"w");
+    if(fp==NULL){
+        cout << "cannot write n the file" << endl;
+        exit(1);
+    }
+    for(size_t i = 0; i < features.size1(); i++){
+        for(size_t j = 0; j < features.size2(); j++){
+            fprintf(fp, "%.6g ",features(i,j));
+        }
+        fprintf(fp, "\n");
+    }
+    if (ferror(fp) != 0 || fclose(fp) != 0){
+        cout << "error in writing the features to the file" << endl;
+        exit(1);
+    }
+    cout << "MFCC features of " << features.size1() << " wav files saved in file named: " << featureFile_ << endl;
+    featureExtraction_.printRealTimeFactor();
+}
+
+std::vector<int> NeuralNetwork::loadLabelSet(char* fileName, int& numClasses){
+
+    //labels are kept as class indices, rows may be one-hot (e.g. +1/-1) or hold a single class number
+    std::vector<int> labels;
+    ifstream infile;
+    infile.open(fileName);
+    if(!infile.is_open()){
+        cout << "Failed to open file" << endl;
+        exit(1);
+    }
+
+    numClasses = 0;
+    string line;
+    while(getline(infile, line)){
+        size_t cols = 0;
+        int label = DataStream::parseLabel(line, cols);
+        if(label < 0)
+            continue;
+        labels.push_back(label);
+        if(cols > 1 && (int)cols > numClasses)
+            numClasses = cols;
+        if(label+1 > numClasses)
+            numClasses = label+1;
+    }
+    infile.close();
+
+    #ifdef DATA_LOADING_DEBUG_INFO
+        cout << "labels: " << labels.size() << " classes: " << numClasses << endl;
+    #endif
+    return labels;
+}
+
 matrix<double> NeuralNetwork::loadDataSet(char* fileName){
 
+    //wav lists are converted to MFCC features in memory
+    if(isWavList(fileName)){
+        featureExtractionFlag_ = true;
+        return featureExtraction_.extractFeatureList(fileName, featureFrames_);
+    }
+
     //ifstream file;
     int cols = 0, rows = 0;
     double buff[MAXBUFSIZE];
@@ -452,11 +1585,17 @@ matrix<double> NeuralNetwork::loadDataSet(char* fileName){
     while (! infile.eof()){
         string line;
         getline(infile, line);
+        if(line.find_first_not_of(" \t\r") == string::npos)
+            continue;
 
         int temp_cols = 0;
         stringstream stream(line);
 
         while(! stream.eof()){
+            if(cols*rows+temp_cols >= MAXBUFSIZE){
+                cout << "data file " << fileName << " has more than " << MAXBUFSIZE << " values" << endl;
+                exit(1);
+            }
             stream >> buff[cols*rows+temp_cols];
             //cout << buff[cols*rows+temp_cols] << " " << endl;
             temp_cols++;
@@ -521,14 +1660,17 @@ void NeuralNetwork::saveTrainedModel(){
         fprintf(fp,"Best_weights_at_interation_number %d\n", bestIndex_);
 
         //fprintf(fp,"trained model parameters for input to hidden nodes\n");
-        fprintf(fp,"wbar\n");
-        for(size_t i = 0; i <  hiddenNodes_-1; i++){
-            for(size_t j = 0; j <  inputNodes_; j++){
-                fprintf(fp, "%.16g ",wbarBest_(i,j));
+        if(sparseWbar_.rows_ > 0){
+            sparseWbar_.save(fp);
+        }else{
+            fprintf(fp,"wbar\n");
+            for(size_t i = 0; i <  hiddenNodes_-1; i++){
+                for(size_t j = 0; j <  inputNodes_; j++){
+                    fprintf(fp, "%.16g ",wbarBest_(i,j));
+                }
             }
+            fprintf(fp, "\n");
         }
-
-        fprintf(fp, "\n");
         fprintf(fp,"w\n");
         //fprintf(fp,"trained model parameters from hidden nodes to output nodes\n");
 
@@ -548,12 +1690,14 @@ void NeuralNetwork::saveTrainedModel(){
 }
 
 
-void NeuralNetwork::loadTrainedModel(){
-    FILE *fp = fopen(modelFile_,"rb");
+void NeuralNetwork::loadTrainedModel(char* fileName){
+    if(fileName == NULL)
+        fileName = modelFile_;
+    FILE *fp = fopen(fileName,"rb");
     bool matrixSetupFlag = false;
     bool matrixReadBreakFlag = false;
 
-    cout << "Neural Network parameters loaded from the model file: " << modelFile_ << endl;
+    cout << "Neural Network parameters loaded from the model file: " << fileName << endl;
     if(fp==NULL){
         cout << "model file cannot be loaded" << endl;
         exit(1);
@@ -577,7 +1721,7 @@ void NeuralNetwork::loadTrainedModel(){
             //cout << "hidden nodes " << hiddenNodes_ << endl;
         }
         else if(strcmp(cmd,"learning_Rate")==0){
-            fscanf(fp,"%f",&learnRate_);
+            fscanf(fp,"%lf",&learnRate_);
             //cout << "learning rate " << learnRate_ << endl;
         }
         else if(strcmp(cmd,"Training_Cycles")==0){
@@ -594,6 +1738,11 @@ void NeuralNetwork::loadTrainedModel(){
             wbarBest_ = zero_matrix<double>(hiddenNodes_-1,inputNodes_);
             matrixSetupFlag = false;
         }
+        if(strcmp(cmd,"wbar_bcsr")==0){
+            //pruned models keep the blocked CSR layer for inference and a dense copy
+            sparseWbar_.load(fp, hiddenNodes_-1, inputNodes_);
+            sparseWbar_.decompress(wbarBest_);
+        }
         if(strcmp(cmd,"wbar")==0){
             while(1){
                 for(size_t i = 0; i <  hiddenNodes_-1; i++){
@@ -648,7 +1797,7 @@ void NeuralNetwork::loadTrainedModel(){
 
 void NeuralNetwork::exit_with_help()
 {
-    if(trainTestFlag_ == 0){
+    if(trainTestFlag_ == TRAIN_MODE){
         printf(
         "Usage: NeuralNetwork [options] trainingDataFile trainingLabelFile validationDataFile validationLabelFile modelFile \n"
         "options:\n"
@@ -656,15 +1805,79 @@ void NeuralNetwork::exit_with_help()
         "-l learning_Rate : (default 0.1)\n"
         "-h number of hidden_nodes : (default calculated using (hiddenNodes_ = ceil((pow(outputNodes_,2.0) + outputNodes_+ 2)/2)+1 \n"
         "-c training cycles : iteration for optimising the weights of NN (default 300)\n"
+        "-f feature frames : frames of MFCC features per sample when data files are .scp wav lists (default 30)\n"
         "-v displays NN parameters : displays the trained paramerters of the model (default will not display)\n"
+        "--max-memory megabytes : train out of core, streaming the data files in chunks that fit in the given memory (default loads all data)\n"
+        "--hogwild threads : trains with the given number of threads updating the shared weights without locks, samples are trained in no fixed order (default off)\n"
+        "--trace file : saves the wall clock time, validation error and classification error of every cycle\n"
+        "--prune sparsities : comma separated fractions of the input to hidden weights removed after training, e.g. 0.5,0.8,0.9; every pruned model is saved as modelFile.sS\n"
+        "--prune-cycles cycles : training cycles fine tuning the remaining weights of every pruned model (default 0)\n"
+        "--init-model file : continues training from the best weights of a saved model instead of random weights, -c sets the cycles of this run\n"
+        "--patience cycles : stops training when the validation error has not improved for the given cycles (default trains all cycles)\n"
         );
-    }if(trainTestFlag_ == 1){
+    }if(trainTestFlag_ == TEST_MODE){
         printf(
         "Usage: NeuralNetwork [options] testingDataFile testingLabelFile modelFile \n"
         "options:\n"
         "-t [test]\n"
+        "-f feature frames : frames of MFCC features per sample when data files are .scp wav lists (default 30)\n"
         "-v displays NN parameters : displays the trained paramerters of the model (default will display)\n"
         );
+    }if(trainTestFlag_ == SWEEP_MODE){
+        printf(
+        "Usage: NeuralNetwork [options] trainingDataFile trainingLabelFile validationDataFile validationLabelFile modelFile \n"
+        "options:\n"
+        "-t [sweep]\n"
+        "-h hidden nodes : comma separated list, e.g. 5,7,9 (default calculated from the output nodes)\n"
+        "-l learning rates : comma separated list, e.g. 0.01,0.05 (default 0.01)\n"
+        "-c training cycles : comma separated list, e.g. 100,300 (default 300)\n"
+        "-j threads : configurations trained at the same time (default number of cores)\n"
+        "--configs file : one configuration per row as hidden_nodes learning_rate cycles, used instead of the -h -l -c grid\n"
+        "The best model of every configuration is saved as modelFile.hH_lL_cC and the ranking in modelFile.summary\n"
+        );
+    }if(trainTestFlag_ == DISTRIBUTED_MODE){
+        printf(
+        "Usage: NeuralNetwork [options] trainingDataFile trainingLabelFile validationDataFile validationLabelFile modelFile \n"
+        "options:\n"
+        "-t [dtrain]\n"
+        "-n processes : training processes, each trains on every n-th training sample (default 2)\n"
+        "-l learning_Rate : (default 0.01)\n"
+        "-h number of hidden_nodes : (default calculated using (hiddenNodes_ = ceil((pow(outputNodes_,2.0) + outputNodes_+ 2)/2)+1 \n"
+        "-c training cycles : iteration for optimising the weights of NN (default 300)\n"
+        "--sync-interval samples : samples trained by every process between two weight averages (default 50)\n"
+        "--transport address : unix:/path/to/socket or tcp:host:port of process 0, required with --rank (default a socket /tmp/NeuralNetwork.PID.sock of this job)\n"
+        "--rank r : run only process r of the n processes, used to start the processes on different machines (default starts all n processes on this machine)\n"
+        "--scaling 1 : trains with 1 to n processes and reports the speedup and scaling efficiency\n"
+        "--hogwild threads, --trace file, --init-model file and --patience cycles as for training, the trace is written and the early stop decided by process 0\n"
+        );
+    }if(trainTestFlag_ == CROSSVALIDATION_MODE){
+        printf(
+        "Usage: NeuralNetwork [options] dataFile labelFile \n"
+        "options:\n"
+        "-t [cv]\n"
+        "-k folds : number of folds the data set is split into (default 5)\n"
+        "-l learning_Rate : (default 0.01)\n"
+        "-h number of hidden_nodes : (default calculated using (hiddenNodes_ = ceil((pow(outputNodes_,2.0) + outputNodes_+ 2)/2)+1 \n"
+        "-c training cycles : iteration for optimising the weights of NN (default 300)\n"
+        "-j threads : folds trained at the same time (default number of cores)\n"
+        );
+    }if(trainTestFlag_ == DECODE_MODE){
+        printf(
+        "Usage: NeuralNetwork [options] frameDataFile lexiconFile modelFile \n"
+        "options:\n"
+        "-t [decode]\n"
+        "-b beam : states scoring below the best state minus the beam are pruned (default 20)\n"
+        "-p word insertion penalty : log penalty added to every word entry (default 0)\n"
+        "-d traceback depth : frames of back pointers kept in memory, at least 2 (default 200)\n"
+        "-f feature frames : frames of MFCC features per sample when data files are .scp wav lists (default 30)\n"
+        );
+    }if(trainTestFlag_ == EXTRACT_MODE){
+        printf(
+        "Usage: NeuralNetwork [options] wavListFile featureFile \n"
+        "options:\n"
+        "-t [extract]\n"
+        "-f feature frames : frames of MFCC features saved per wav file (default 30)\n"
+        );
     }
     exit(1);
 }
@@ -685,27 +1898,100 @@ void NeuralNetwork::parse_command_line(int argc, char **argv){
         {
             case 't':
                 if(strcmp(argv[i],"train")==0){
-                    trainTestFlag_ = 0;
+                    trainTestFlag_ = TRAIN_MODE;
                     //cout << "train test flag " << trainTestFlag_ << endl;
                 }
                 if(strcmp(argv[i],"test")==0){
-                    trainTestFlag_ = 1;
+                    trainTestFlag_ = TEST_MODE;
                     //cout << "train test flag " << trainTestFlag_ << endl;
                 }
+                if(strcmp(argv[i],"extract")==0){
+                    trainTestFlag_ = EXTRACT_MODE;
+                }
+                if(strcmp(argv[i],"decode")==0){
+                    trainTestFlag_ = DECODE_MODE;
+                }
+                if(strcmp(argv[i],"sweep")==0){
+                    trainTestFlag_ = SWEEP_MODE;
+                }
+                if(strcmp(argv[i],"cv")==0){
+                    trainTestFlag_ = CROSSVALIDATION_MODE;
+                }
+                if(strcmp(argv[i],"dtrain")==0){
+                    trainTestFlag_ = DISTRIBUTED_MODE;
+                }
                 break;
             case 'l':
+                learnRateList_ = argv[i];
                 learnRate_ = atof(argv[i]);
                 //cout << "learing rate " << atof(argv[i]) << endl;
                 break;
             case 'h':
                 hiddenNodeDefaultFlag_ = 1;
+                hiddenNodeList_ = argv[i];
                 hiddenNodes_ = atoi(argv[i]);
                 //cout << "hiddenNodes " << atoi(argv[i]) << endl;
                 break;
             case 'c':
+                cycleList_ = argv[i];
                 numCycle_ = atoi(argv[i]);
                  //cout <<  "training cycles " << atoi(argv[i]) << endl;
                 break;
+            case 'f':
+                featureFrames_ = atoi(argv[i]);
+                if(featureFrames_ < 1){
+                    cout << "feature frames must be at least 1" << endl;
+                    exit(1);
+                }
+                break;
+            case 'j':
+                numThreads_ = atoi(argv[i]);
+                break;
+            case 'k':
+                numFolds_ = atoi(argv[i]);
+                break;
+            case 'n':
+                worldSize_ = atoi(argv[i]);
+                break;
+            case 'b':
+                viterbiDecoder_.beam_ = atof(argv[i]);
+                break;
+            case 'p':
+                viterbiDecoder_.wordPenalty_ = atof(argv[i]);
+                break;
+            case 'd':
+                viterbiDecoder_.tracebackDepth_ = atoi(argv[i]);
+                if(viterbiDecoder_.tracebackDepth_ < 2){
+                    cout << "traceback depth must be at least 2 frames" << endl;
+                    exit(1);
+                }
+                break;
+            case '-':
+                if(strcmp(argv[i-1],"--max-memory")==0)
+                    maxMemory_ = atof(argv[i]);
+                if(strcmp(argv[i-1],"--hogwild")==0)
+                    hogwildThreads_ = atoi(argv[i]);
+                if(strcmp(argv[i-1],"--trace")==0)
+                    traceFileName_ = argv[i];
+                if(strcmp(argv[i-1],"--prune")==0)
+                    pruneList_ = argv[i];
+                if(strcmp(argv[i-1],"--prune-cycles")==0)
+                    pruneCycles_ = atoi(argv[i]);
+                if(strcmp(argv[i-1],"--init-model")==0)
+                    initModelFile_ = argv[i];
+                if(strcmp(argv[i-1],"--patience")==0)
+                    patience_ = atoi(argv[i]);
+                if(strcmp(argv[i-1],"--configs")==0)
+                    sweepConfigFile_ = argv[i];
+                if(strcmp(argv[i-1],"--rank")==0)
+                    rank_ = atoi(argv[i]);
+                if(strcmp(argv[i-1],"--transport")==0)
+                    transportAddress_ = argv[i];
+                if(strcmp(argv[i-1],"--sync-interval")==0)
+                    syncInterval_ = atoi(argv[i]);
+                if(strcmp(argv[i-1],"--scaling")==0)
+                    scalingFlag_ = (atoi(argv[i]) != 0);
+                break;
             case 'v':
                 verbose_ = atoi(argv[i]);
                 //cout << "verbose " << atoi(argv[i]);
@@ -714,7 +2000,7 @@ void NeuralNetwork::parse_command_line(int argc, char **argv){
 
     }
 
-    if(i+5 == argc && trainTestFlag_ == 0){
+    if(i+5 == argc && (trainTestFlag_ == TRAIN_MODE || trainTestFlag_ == SWEEP_MODE || trainTestFlag_ == DISTRIBUTED_MODE)){
         trainingDataFile_ = argv[i];
         trainingDataFileLabel_ = argv[i+1];
         validationDataFile_ = argv[i+2];
@@ -727,7 +2013,7 @@ void NeuralNetwork::parse_command_line(int argc, char **argv){
             cout << "validation data label file name: " << validationDataFileLabel_ << endl;
             cout << "Neural Network Trained Model will be saved with file name: " << modelFile_ << endl;
         #endif
-    }else if(i+3 == argc && trainTestFlag_ == 1){
+    }else if(i+3 == argc && trainTestFlag_ == TEST_MODE){
         testingDataFile_ = argv[i];
         testingDataFileLabel_ = argv[i+1];
         modelFile_ = argv[i+2];
@@ -736,6 +2022,29 @@ void NeuralNetwork::parse_command_line(int argc, char **argv){
             cout << "testing data label file name: " << testingDataFileLabel_ << endl;
             cout << "Neural Network Testing Model file name: " << modelFile_ << endl;
         #endif
+    }else if(i+2 == argc && trainTestFlag_ == CROSSVALIDATION_MODE){
+        trainingDataFile_ = argv[i];
+        trainingDataFileLabel_ = argv[i+1];
+        #ifdef COMMANDLINE_ARGUMENT_PARSING_DEBUG_INFO
+            cout << "cross validation data file name: " << trainingDataFile_ << endl;
+            cout << "cross validation label file name: " << trainingDataFileLabel_ << endl;
+        #endif
+    }else if(i+3 == argc && trainTestFlag_ == DECODE_MODE){
+        decodingDataFile_ = argv[i];
+        lexiconFile_ = argv[i+1];
+        modelFile_ = argv[i+2];
+        #ifdef COMMANDLINE_ARGUMENT_PARSING_DEBUG_INFO
+            cout << "decoding data file name: " << decodingDataFile_ << endl;
+            cout << "lexicon file name: " << lexiconFile_ << endl;
+            cout << "Neural Network Decoding Model file name: " << modelFile_ << endl;
+        #endif
+    }else if(i+2 == argc && trainTestFlag_ == EXTRACT_MODE){
+        wavListFile_ = argv[i];
+        featureFile_ = argv[i+1];
+        #ifdef COMMANDLINE_ARGUMENT_PARSING_DEBUG_INFO
+            cout << "wav list file name: " << wavListFile_ << endl;
+            cout << "MFCC features will be saved with file name: " << featureFile_ << endl;
+        #endif
     }else{
         cout << "ask for help" << endl;
         exit_with_help();
@@ -10,6 +10,12 @@
 #include <math.h>
 #include <ctime>
 #include <cmath>
+#include <cfloat>
+#include <cstdio>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <signal.h>
 
 // Boost
 #include <boost/numeric/ublas/io.hpp>
@@ -19,6 +25,17 @@
 #include <boost/scoped_ptr.hpp>
 #include <boost/numeric/conversion/converter_policies.hpp>
 #include <boost/random.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/atomic.hpp>
+
+#include "featureextraction.h"
+#include "viterbidecoder.h"
+#include "datastream.h"
+#include "transport.h"
+#include "sparselayer.h"
 
 using namespace std;
 using namespace boost::numeric::ublas;
@@ -26,6 +43,21 @@ using namespace boost;
 #define MAXBUFSIZE 500000
 #define NUMBEROFTRAININGCYCLE 300
 #define LEARNINGCONSTANT 0.01
+#define NUMBEROFFEATUREFRAMES 30
+#define CROSSVALIDATIONFOLDS 5
+#define DISTRIBUTEDPROCESSES 2
+#define SYNCINTERVAL 50
+#define WORKERPOLLMS 50
+#define PRUNETIMINGSECONDS 0.2
+
+//modes selected with the -t option
+#define TRAIN_MODE 0
+#define TEST_MODE 1
+#define EXTRACT_MODE 2
+#define DECODE_MODE 3
+#define SWEEP_MODE 4
+#define CROSSVALIDATION_MODE 5
+#define DISTRIBUTED_MODE 6
 
 #define NEURAL_NETWORK_TRAINING_UPDATE_DEBUG_INFO
 #define NEURAL_NETWORK_PARAMETER_DEBUG_INFO
@@ -42,18 +74,46 @@ class NeuralNetwork
 {
 
     matrix<double> loadDataSet(char* fileName);
+    void loadTrainingData();
+    void shareTrainingData(NeuralNetwork& worker);
+    static void runConcurrently(std::vector<NeuralNetwork*>& jobs, int numThreads);
+    static void runJobs(std::vector<NeuralNetwork*>* jobs, size_t* nextJob, boost::mutex* jobMutex);
+    std::vector<int> loadLabelSet(char* fileName, int& numClasses);
+    void trainValidateNeuralNetworkOutOfCore();
+    double runDistributedWorker();
+    double launchDistributedWorkers(int worldSize);
+    void packWeights(std::vector<double>& weights);
+    void unpackWeights(const std::vector<double>& weights);
+    void startWeightAveraging();
+    void finishWeightAveraging();
+    void initialiseWeights();
+    void initialiseWeightsFromModel();
+    void printTrainedModel();
     void validateNeuralNetwork();
+    double validationError();
+    void updateBestWeights();
     void trainNeuralNetwork();
+    void trainNeuralNetworkHogwild();
+    void hogwildWorker(boost::atomic<size_t>* cursor, double* error);
+    void writeTrace();
+    void pruneNeuralNetwork();
+    void pruneBlocks(const matrix<double>& weights, double sparsity, matrix<double>& mask);
+    void applyPruneMask();
+    void forwardBest(const double* x, double* Y, double* Z);
+    double inferenceMicroseconds(const std::vector<double>& inputs, const std::vector<int>& labels, double& classificationError);
     void saveTrainedModel();
     double randomNumberGenerator();
+    bool isWavList(char* fileName);
+    void computePosteriors(const double* x, double* Y, double* posteriors);
 
-    //boost matrices used for various mathematical operation
-    matrix<double> trainingData_;
-    matrix<double> trainingLabels_;
-    matrix<double> validationData_;
-    matrix<double> validationLabels_;
+    //boost matrices used for various mathematical operation, labels are stored as class indices
+    //training and validation sets are shared read only between the networks of a sweep
+    boost::shared_ptr<matrix<double> > trainingData_;
+    boost::shared_ptr<std::vector<int> > trainingLabels_;
+    boost::shared_ptr<matrix<double> > validationData_;
+    boost::shared_ptr<std::vector<int> > validationLabels_;
     matrix<double> testingData_;
-    matrix<double> testingLabels_;
+    std::vector<int> testingLabels_;
     matrix<double> eValidation_;
     matrix<double> cyclicError_;
     matrix<double> nnWeight_;
@@ -61,11 +121,39 @@ class NeuralNetwork
     matrix<double> wBest_;
     matrix<double> wbarBest_;
 
+    //columns of trainingData_ and validationData_ used for training and validation, in order
+    std::vector<size_t> trainingOrder_;
+    std::vector<size_t> validationOrder_;
+
+    //chunked readers used by out of core training
+    DataStream trainingStream_;
+    DataStream validationStream_;
+
+    //connection to the other processes of distributed training, the averaging of a snapshot of the
+    //weights (sentWeights_) runs on averagingThread_ while the next samples are trained
+    boost::shared_ptr<Transport> transport_;
+    boost::thread averagingThread_;
+    std::vector<double> sentWeights_;
+    std::vector<double> averagedWeights_;
+
+    //blocked CSR copy of wbarBest_ for pruned models, and the 0/1 mask kept while fine tuning them
+    SparseLayer sparseWbar_;
+    matrix<double> pruneMask_;
+
+    //MFCC front end used when data files are lists of wav files
+    FeatureExtraction featureExtraction_;
+
+    //Viterbi search over the frame posteriors of the NN
+    ViterbiDecoder viterbiDecoder_;
+
     //Global variables
     int inputNodes_;
     int outputNodes_;
     int bestIndex_;
     double lowestError_;
+    int validationMistakes_;
+    double classificationError_;
+    double bestClassificationError_;
     int step_;
     double learnRate_;
     int cycle_;
@@ -75,6 +163,31 @@ class NeuralNetwork
     int predictionCount_;
     bool hiddenNodeDefaultFlag_;
     bool printInfoFlag_;
+    int featureFrames_;
+    bool featureExtractionFlag_;
+    double maxMemory_;
+    int numThreads_;
+    int numFolds_;
+    int rank_;
+    int worldSize_;
+    int syncInterval_;
+    bool scalingFlag_;
+    string transportAddress_;
+    int hogwildThreads_;
+    int pruneCycles_;
+    int patience_;
+
+    //comma separated sparsities of --prune, e.g. 0.5,0.8,0.9
+    string pruneList_;
+
+    //--trace file of the validation error against the wall clock time of every cycle
+    FILE* traceFile_;
+    boost::posix_time::ptime traceStartTime_;
+
+    //comma separated values of -h, -l and -c used as the grid of a sweep
+    string hiddenNodeList_;
+    string learnRateList_;
+    string cycleList_;
 
     //Pointers for file names to be loaded/saved
     char* trainingDataFile_;
@@ -84,6 +197,13 @@ class NeuralNetwork
     char* modelFile_;
     char* testingDataFile_;
     char* testingDataFileLabel_;
+    char* wavListFile_;
+    char* featureFile_;
+    char* decodingDataFile_;
+    char* lexiconFile_;
+    char* sweepConfigFile_;
+    char* traceFileName_;
+    char* initModelFile_;
 
 
 public:
@@ -92,8 +212,14 @@ public:
     void testNeuralNetwork();
     void exit_with_help();
     void parse_command_line(int argc, char **argv);
-    void loadTrainedModel();
-    bool trainTestFlag_;
+    void loadTrainedModel(char* fileName = NULL);
+    void extractFeatures();
+    void decodeNeuralNetwork();
+    void sweepNeuralNetwork();
+    void crossValidateNeuralNetwork();
+    void distributedTrainNeuralNetwork();
+    void trainCycles();
+    int trainTestFlag_;
 
 
 };
@@ -0,0 +1,166 @@
+/* ***************************************************************************************
+ * SPARSE LAYER: Blocked CSR storage and inference kernel for pruned weight matrices.
+ * Magnitude pruning removes whole 1x4 blocks of the input to hidden weights, so every stored
+ * block is multiplied with four consecutive inputs by two SSE2 double multiplies, without
+ * gathering single columns. multiplyDense() is the matching SSE2 kernel for dense layers, so
+ * pruned and dense models are timed with the same code.
+ *
+ * MODEL FORMAT: "wbar_bcsr" followed by the number of blocks, the rows+1 row start offsets,
+ * the first column of every block and the SPARSEBLOCKSIZE weights of every block.
+*/
+#include "sparselayer.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+SparseLayer::SparseLayer()
+{
+    rows_ = 0;
+    cols_ = 0;
+    paddedCols_ = 0;
+}
+
+size_t SparseLayer::numBlocks() const{
+    return blockColumns_.size();
+}
+
+void SparseLayer::compress(const matrix<double>& m){
+
+    rows_ = m.size1();
+    cols_ = m.size2();
+    paddedCols_ = (cols_ + SPARSEBLOCKSIZE - 1)/SPARSEBLOCKSIZE*SPARSEBLOCKSIZE;
+    rowStart_.assign(1, 0);
+    blockColumns_.clear();
+    values_.clear();
+
+    for(size_t i = 0; i < rows_; i++){
+        for(size_t j = 0; j < cols_; j += SPARSEBLOCKSIZE){
+            bool nonZero = false;
+            for(size_t k = j; k < j + SPARSEBLOCKSIZE && k < cols_; k++){
+                if(m(i,k) != 0)
+                    nonZero = true;
+            }
+            if(nonZero == false)
+                continue;
+            blockColumns_.push_back(j);
+            for(size_t k = j; k < j + SPARSEBLOCKSIZE; k++){
+                values_.push_back((k < cols_) ? m(i,k) : 0);
+            }
+        }
+        rowStart_.push_back(blockColumns_.size());
+    }
+
+    #ifdef SPARSE_LAYER_DEBUG_INFO
+        cout << "sparse layer " << rows_ << "x" << cols_ << " blocks: " << numBlocks() << " of " << rows_*paddedCols_/SPARSEBLOCKSIZE << endl;
+    #endif
+}
+
+void SparseLayer::decompress(matrix<double>& m) const{
+
+    m = zero_matrix<double>(rows_, cols_);
+    for(size_t i = 0; i < rows_; i++){
+        for(int b = rowStart_[i]; b < rowStart_[i+1]; b++){
+            for(size_t k = 0; k < SPARSEBLOCKSIZE && blockColumns_[b] + k < cols_; k++){
+                m(i, blockColumns_[b] + k) = values_[b*SPARSEBLOCKSIZE + k];
+            }
+        }
+    }
+}
+
+void SparseLayer::multiply(const double* x, double* y) const{
+
+    const double* values = values_.empty() ? NULL : &values_[0];
+    for(size_t i = 0; i < rows_; i++){
+        int b = rowStart_[i];
+        double sum = 0;
+#ifdef __SSE2__
+        __m128d acc0 = _mm_setzero_pd();
+        __m128d acc1 = _mm_setzero_pd();
+        for(; b < rowStart_[i+1]; b++){
+            const double* v = values + b*SPARSEBLOCKSIZE;
+            const double* in = x + blockColumns_[b];
+            acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_loadu_pd(v), _mm_loadu_pd(in)));
+            acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_loadu_pd(v+2), _mm_loadu_pd(in+2)));
+        }
+        double lanes[2];
+        _mm_storeu_pd(lanes, _mm_add_pd(acc0, acc1));
+        sum = lanes[0] + lanes[1];
+#endif
+        for(; b < rowStart_[i+1]; b++){
+            const double* v = values + b*SPARSEBLOCKSIZE;
+            const double* in = x + blockColumns_[b];
+            sum = sum + v[0]*in[0] + v[1]*in[1] + v[2]*in[2] + v[3]*in[3];
+        }
+        y[i] = sum;
+    }
+}
+
+void SparseLayer::multiplyDense(const matrix<double>& m, const double* x, double* y){
+
+    size_t cols = m.size2();
+    for(size_t i = 0; i < m.size1(); i++){
+        const double* row = &m.data()[0] + i*cols;
+        size_t j = 0;
+        double sum = 0;
+#ifdef __SSE2__
+        __m128d acc = _mm_setzero_pd();
+        for(; j + 2 <= cols; j += 2){
+            acc = _mm_add_pd(acc, _mm_mul_pd(_mm_loadu_pd(row+j), _mm_loadu_pd(x+j)));
+        }
+        double lanes[2];
+        _mm_storeu_pd(lanes, acc);
+        sum = lanes[0] + lanes[1];
+#endif
+        for(; j < cols; j++){
+            sum = sum + row[j]*x[j];
+        }
+        y[i] = sum;
+    }
+}
+
+void SparseLayer::save(FILE* fp) const{
+
+    fprintf(fp,"wbar_bcsr %d\n", (int)numBlocks());
+    for(size_t i = 0; i <= rows_; i++){
+        fprintf(fp, "%d ", rowStart_[i]);
+    }
+    fprintf(fp, "\n");
+    for(size_t b = 0; b < numBlocks(); b++){
+        fprintf(fp, "%d ", blockColumns_[b]);
+    }
+    fprintf(fp, "\n");
+    for(size_t k = 0; k < values_.size(); k++){
+        fprintf(fp, "%.16g ", values_[k]);
+    }
+    fprintf(fp, "\n");
+}
+
+void SparseLayer::load(FILE* fp, size_t rows, size_t cols){
+
+    rows_ = rows;
+    cols_ = cols;
+    paddedCols_ = (cols_ + SPARSEBLOCKSIZE - 1)/SPARSEBLOCKSIZE*SPARSEBLOCKSIZE;
+    int blocks = 0;
+    if(fscanf(fp,"%d",&blocks) != 1 || blocks < 0){
+        cout << "invalid wbar_bcsr section in the model file" << endl;
+        exit(1);
+    }
+    rowStart_.resize(rows_+1);
+    blockColumns_.resize(blocks);
+    values_.resize(blocks*SPARSEBLOCKSIZE);
+    bool valid = true;
+    for(size_t i = 0; i <= rows_ && valid; i++){
+        valid = (fscanf(fp,"%d",&rowStart_[i]) == 1) && (i == 0 || rowStart_[i] >= rowStart_[i-1]);
+    }
+    for(int b = 0; b < blocks && valid; b++){
+        valid = (fscanf(fp,"%d",&blockColumns_[b]) == 1) && blockColumns_[b] >= 0 && blockColumns_[b] + SPARSEBLOCKSIZE <= (int)paddedCols_;
+    }
+    for(size_t k = 0; k < values_.size() && valid; k++){
+        valid = (fscanf(fp,"%lf",&values_[k]) == 1);
+    }
+    if(!valid || rowStart_[0] != 0 || rowStart_[rows_] != blocks){
+        cout << "invalid wbar_bcsr section in the model file" << endl;
+        exit(1);
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef SPARSELAYER_H
+#define SPARSELAYER_H
+
+#include <vector>
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+
+// Boost
+#include <boost/numeric/ublas/matrix.hpp>
+
+using namespace std;
+using namespace boost::numeric::ublas;
+
+#define SPARSEBLOCKSIZE 4
+
+//#define SPARSE_LAYER_DEBUG_INFO
+
+
+/* ***************************************************************************************
+ * Weight matrix of a pruned layer in blocked CSR format. Every row keeps only the blocks of
+ * SPARSEBLOCKSIZE consecutive columns that have a non zero weight. The input vectors of
+ * multiply() must hold paddedCols_ values, the columns past cols_ being zero.
+*/
+class SparseLayer
+{
+    //blocks of row r are rowStart_[r] to rowStart_[r+1]-1, block b starts at column blockColumns_[b]
+    std::vector<int> rowStart_;
+    std::vector<int> blockColumns_;
+    std::vector<double> values_;
+
+public:
+    SparseLayer();
+    void compress(const matrix<double>& m);
+    void decompress(matrix<double>& m) const;
+    void multiply(const double* x, double* y) const;
+    static void multiplyDense(const matrix<double>& m, const double* x, double* y);
+    void save(FILE* fp) const;
+    void load(FILE* fp, size_t rows, size_t cols);
+    size_t numBlocks() const;
+    size_t rows_;
+    size_t cols_;
+    size_t paddedCols_;
+};
+
+#endif // SPARSELAYER_H
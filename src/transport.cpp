@@ -0,0 +1,202 @@
+/* ***************************************************************************************
+ * TRANSPORT: Stream socket implementation of the Transport interface with boost::asio.
+ * The same code serves local (unix domain) sockets and TCP sockets. Process 0 listens on the
+ * address and every other process connects to it and sends its rank. Vectors are exchanged as
+ * raw doubles, so all processes must run on machines with the same double representation.
+*/
+#include "transport.h"
+
+#include <unistd.h>
+
+// Boost
+#include <boost/asio.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/bind.hpp>
+
+using boost::asio::ip::tcp;
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+using boost::asio::local::stream_protocol;
+#endif
+
+// TCP sockets send small messages at once instead of waiting for more data
+static void configureSocket(tcp::socket& socket){
+    socket.set_option(tcp::no_delay(true));
+}
+
+static void configureAcceptor(tcp::acceptor& acceptor){
+    acceptor.set_option(tcp::acceptor::reuse_address(true));
+}
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+static void configureSocket(stream_protocol::socket&){
+}
+
+static void configureAcceptor(stream_protocol::acceptor&){
+}
+#endif
+
+template<class Protocol>
+class SocketTransport : public Transport
+{
+    typedef typename Protocol::socket Socket;
+    typedef boost::shared_ptr<Socket> SocketPtr;
+
+    boost::asio::io_service ioService_;
+    std::vector<SocketPtr> peers_;
+    std::vector<double> receiveBuffer_;
+    int rank_;
+    int worldSize_;
+
+    //a process that dies takes the whole job down, the reductions cannot complete without it
+    void lostConnection(const std::exception& e){
+        cout << "process " << rank_ << " lost the connection to the other processes: " << e.what() << endl;
+        exit(1);
+    }
+
+    static void acceptDone(const boost::system::error_code& error, boost::system::error_code* result){
+        *result = error;
+    }
+
+    static void acceptTimeout(const boost::system::error_code& error, typename Protocol::acceptor* acceptor){
+        if(!error)
+            acceptor->cancel();
+    }
+
+public:
+    SocketTransport(const typename Protocol::endpoint& endpoint, int rank, int worldSize){
+
+        rank_ = rank;
+        worldSize_ = worldSize;
+        if(rank_ == 0){
+            //peers_[r-1] is the connection to process r
+            peers_.resize(worldSize_-1);
+            typename Protocol::acceptor acceptor(ioService_);
+            acceptor.open(endpoint.protocol());
+            configureAcceptor(acceptor);
+            acceptor.bind(endpoint);
+            acceptor.listen();
+
+            //a process that dies before connecting must not keep process 0 waiting forever
+            boost::asio::deadline_timer timer(ioService_);
+            timer.expires_from_now(boost::posix_time::seconds(TRANSPORTACCEPTSECONDS));
+            timer.async_wait(boost::bind(&SocketTransport::acceptTimeout, boost::asio::placeholders::error, &acceptor));
+            for(int i = 1; i < worldSize_; i++){
+                SocketPtr socket(new Socket(ioService_));
+                boost::system::error_code error = boost::asio::error::would_block;
+                acceptor.async_accept(*socket, boost::bind(&SocketTransport::acceptDone, boost::asio::placeholders::error, &error));
+                while(error == boost::asio::error::would_block){
+                    ioService_.run_one();
+                }
+                if(error == boost::asio::error::operation_aborted){
+                    cout << "process 0 timed out after " << TRANSPORTACCEPTSECONDS << " seconds waiting for the other processes to connect" << endl;
+                    exit(1);
+                }
+                if(error)
+                    throw boost::system::system_error(error);
+                configureSocket(*socket);
+                int peerRank = 0;
+                boost::asio::read(*socket, boost::asio::buffer(&peerRank, sizeof(int)));
+                if(peerRank < 1 || peerRank >= worldSize_ || peers_[peerRank-1]){
+                    cout << "invalid rank " << peerRank << " connected to process 0" << endl;
+                    exit(1);
+                }
+                peers_[peerRank-1] = socket;
+            }
+            timer.cancel();
+            ioService_.run();
+        }else{
+            //process 0 may not be listening yet
+            SocketPtr socket(new Socket(ioService_));
+            boost::system::error_code error;
+            for(int retry = 0; retry < TRANSPORTCONNECTRETRIES; retry++){
+                socket->connect(endpoint, error);
+                if(!error)
+                    break;
+                socket->close();
+                boost::this_thread::sleep(boost::posix_time::milliseconds(TRANSPORTCONNECTRETRYMS));
+            }
+            if(error){
+                cout << "process " << rank_ << " cannot connect to process 0: " << error.message() << endl;
+                exit(1);
+            }
+            configureSocket(*socket);
+            boost::asio::write(*socket, boost::asio::buffer(&rank_, sizeof(int)));
+            peers_.push_back(socket);
+        }
+
+        #ifdef TRANSPORT_DEBUG_INFO
+            cout << "process " << rank_ << " of " << worldSize_ << " connected" << endl;
+        #endif
+    }
+
+    void allReduceMean(std::vector<double>& values){
+
+        size_t bytes = values.size()*sizeof(double);
+        try{
+            if(rank_ == 0){
+                receiveBuffer_.resize(values.size());
+                for(size_t p = 0; p < peers_.size(); p++){
+                    boost::asio::read(*peers_[p], boost::asio::buffer(&receiveBuffer_[0], bytes));
+                    for(size_t i = 0; i < values.size(); i++){
+                        values[i] = values[i] + receiveBuffer_[i];
+                    }
+                }
+                for(size_t i = 0; i < values.size(); i++){
+                    values[i] = values[i]/worldSize_;
+                }
+                for(size_t p = 0; p < peers_.size(); p++){
+                    boost::asio::write(*peers_[p], boost::asio::buffer(&values[0], bytes));
+                }
+            }else{
+                boost::asio::write(*peers_[0], boost::asio::buffer(&values[0], bytes));
+                boost::asio::read(*peers_[0], boost::asio::buffer(&values[0], bytes));
+            }
+        }catch(const std::exception& e){
+            lostConnection(e);
+        }
+    }
+
+    void broadcast(std::vector<double>& values){
+
+        size_t bytes = values.size()*sizeof(double);
+        try{
+            if(rank_ == 0){
+                for(size_t p = 0; p < peers_.size(); p++){
+                    boost::asio::write(*peers_[p], boost::asio::buffer(&values[0], bytes));
+                }
+            }else{
+                boost::asio::read(*peers_[0], boost::asio::buffer(&values[0], bytes));
+            }
+        }catch(const std::exception& e){
+            lostConnection(e);
+        }
+    }
+};
+
+Transport* createTransport(const string& address, int rank, int worldSize){
+
+    try{
+        if(address.compare(0, 4, "tcp:") == 0){
+            size_t colon = address.rfind(':');
+            string host = address.substr(4, colon-4);
+            unsigned short port = boost::lexical_cast<unsigned short>(address.substr(colon+1));
+            tcp::endpoint endpoint(boost::asio::ip::address::from_string(host), port);
+            return new SocketTransport<tcp>(endpoint, rank, worldSize);
+        }
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+        if(address.compare(0, 5, "unix:") == 0){
+            string path = address.substr(5);
+            if(rank == 0)
+                unlink(path.c_str());
+            return new SocketTransport<stream_protocol>(stream_protocol::endpoint(path), rank, worldSize);
+        }
+#endif
+    }catch(const std::exception& e){
+        cout << "transport " << address << " failed: " << e.what() << endl;
+        exit(1);
+    }
+    cout << "unknown transport address " << address << ", use unix:/path or tcp:host:port" << endl;
+    exit(1);
+}
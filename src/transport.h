@@ -0,0 +1,38 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <cstdlib>
+
+using namespace std;
+
+//local socket of a job started by one launcher, named after the pid of the launcher
+#define DEFAULTTRANSPORTPATH "/tmp/NeuralNetwork.%d.sock"
+#define TRANSPORTCONNECTRETRIES 400
+#define TRANSPORTCONNECTRETRYMS 50
+#define TRANSPORTACCEPTSECONDS 120
+
+//#define TRANSPORT_DEBUG_INFO
+
+
+/* ***************************************************************************************
+ * Communication between the processes of distributed training. Process 0 accepts a connection
+ * from every other process; reductions are gathered on process 0 and sent back to everyone.
+ * createTransport() picks the implementation from the address, "unix:/path/to/socket" for a
+ * local socket or "tcp:host:port" for a TCP connection.
+*/
+class Transport
+{
+public:
+    virtual ~Transport() {}
+    // replaces values by the mean of the values of all processes
+    virtual void allReduceMean(std::vector<double>& values) = 0;
+    // replaces values by the values of process 0
+    virtual void broadcast(std::vector<double>& values) = 0;
+};
+
+Transport* createTransport(const string& address, int rank, int worldSize);
+
+#endif // TRANSPORT_H
@@ -0,0 +1,333 @@
+/* ***************************************************************************************
+ * VITERBI DECODER: Decodes the frame by class posteriors of the Neural Network into a sequence
+ * of words and classes (phones) with a log domain Viterbi search.
+ *
+ * LEXICON FILE: Each row holds a word followed by the classes of its left to right HMM states,
+ * where classes are the output nodes of the NN numbered from 1 (as reported by the testing mode).
+ * Lines starting with # are ignored. Example:
+ *     yes 3 1 4
+ *     no 2 5
+ * Every state has a self loop of probability SELFLOOPPROBABILITY and any word can follow any
+ * other word with a uniform probability plus the word insertion penalty.
+ *
+ * SEARCH: The max-plus recursion over all states of a frame is done with SSE (4 states at a
+ * time) and states scoring worse than the best state minus the beam are pruned. Back pointers
+ * are stored in a ring buffer of tracebackDepth_ frames; when it fills up the oldest half is
+ * committed by tracing back from the current best state, and the states whose traceback leaves
+ * the committed path are pruned so the final traceback always continues it.
+*/
+#include "viterbidecoder.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+ViterbiDecoder::ViterbiDecoder()
+{
+    numStates_ = 0;
+    paddedStates_ = 0;
+    ringHead_ = 0;
+    ringCount_ = 0;
+    frameCount_ = 0;
+    decodedFrames_ = 0;
+    decodingSeconds_ = 0;
+    beam_ = DECODERBEAM;
+    wordPenalty_ = WORDINSERTIONPENALTY;
+    tracebackDepth_ = TRACEBACKDEPTH;
+}
+
+void ViterbiDecoder::loadLexicon(const char* fileName){
+
+    ifstream infile;
+    infile.open(fileName);
+    if(!infile.is_open()){
+        cout << "Failed to open lexicon file" << endl;
+        exit(1);
+    }
+
+    words_.clear();
+    wordStart_.clear();
+    wordEnd_.clear();
+    stateClass_.clear();
+    stateWord_.clear();
+    string line;
+    while(getline(infile, line)){
+        stringstream stream(line);
+        string word;
+        if(!(stream >> word) || word[0] == '#')
+            continue;
+        int classIndex;
+        int start = stateClass_.size();
+        while(stream >> classIndex){
+            stateClass_.push_back(classIndex);
+            stateWord_.push_back(words_.size());
+        }
+        if((int)stateClass_.size() == start){
+            cout << "word without states in lexicon file: " << word << endl;
+            exit(1);
+        }
+        words_.push_back(word);
+        wordStart_.push_back(start);
+        wordEnd_.push_back(stateClass_.size()-1);
+    }
+    infile.close();
+    if(words_.size() == 0){
+        cout << "lexicon file is empty" << endl;
+        exit(1);
+    }
+
+    //pad the states to a multiple of 4 so the recursion needs no scalar tail
+    numStates_ = stateClass_.size();
+    paddedStates_ = (numStates_ + 3)/4*4;
+    stateClass_.resize(paddedStates_, 1);
+    stateWord_.resize(paddedStates_, 0);
+    selfLog_.assign(paddedStates_, LOGZERO);
+    enterLog_.assign(paddedStates_, LOGZERO);
+    for(int s = 0; s < numStates_; s++){
+        selfLog_[s] = log(SELFLOOPPROBABILITY);
+        if(s != wordStart_[stateWord_[s]])
+            enterLog_[s] = log(1 - SELFLOOPPROBABILITY);
+    }
+
+    #ifdef VITERBI_DECODER_DEBUG_INFO
+        cout << "lexicon words: " << words_.size() << " states: " << numStates_ << endl;
+    #endif
+}
+
+void ViterbiDecoder::commitFrames(int numFrames, int lastState){
+
+    //trace back through every frame of the ring buffer, newest to oldest
+    std::vector<int> path(ringCount_);
+    std::vector<unsigned char> entry(ringCount_);
+    int state = lastState;
+    for(int f = ringCount_-1; f >= 0; f--){
+        int slot = (ringHead_ + f) % tracebackDepth_;
+        unsigned char bp = backPointer_[slot*paddedStates_ + state];
+        path[f] = state;
+        entry[f] = (bp == 2);
+        if(bp == 1)
+            state = state - 1;
+        else if(bp == 2)
+            state = exitState_[slot];
+        if(state < 0)
+            state = 0;
+    }
+
+    for(int f = 0; f < numFrames; f++){
+        committedState_.push_back(path[f]);
+        committedEntry_.push_back(entry[f]);
+    }
+    ringHead_ = (ringHead_ + numFrames) % tracebackDepth_;
+    ringCount_ = ringCount_ - numFrames;
+}
+
+void ViterbiDecoder::pruneUncommittedStates(float* scores){
+
+    //trace every surviving state back through the frames left in the ring buffer
+    int committed = committedState_.back();
+    for(int s = 0; s < numStates_; s++){
+        if(scores[s] <= LOGZERO)
+            continue;
+        int state = s;
+        for(int f = ringCount_-1; f >= 0; f--){
+            int slot = (ringHead_ + f) % tracebackDepth_;
+            unsigned char bp = backPointer_[slot*paddedStates_ + state];
+            if(bp == 1)
+                state = state - 1;
+            else if(bp == 2)
+                state = exitState_[slot];
+            if(state < 0)
+                state = 0;
+        }
+        if(state != committed)
+            scores[s] = LOGZERO;
+    }
+}
+
+void ViterbiDecoder::startDecoding(int numClasses){
+
+    for(int s = 0; s < numStates_; s++){
+        if(stateClass_[s] < 1 || stateClass_[s] > numClasses){
+            cout << "lexicon class " << stateClass_[s] << " is not an output of the neural network" << endl;
+            exit(1);
+        }
+    }
+
+    previousScore_.assign(paddedStates_+1, LOGZERO);
+    currentScore_.assign(paddedStates_+1, LOGZERO);
+    emission_.assign(paddedStates_, 0);
+    logPosterior_.assign(numClasses, 0);
+    backPointer_.assign(tracebackDepth_*paddedStates_, 0);
+    exitState_.assign(tracebackDepth_, -1);
+    ringHead_ = 0;
+    ringCount_ = 0;
+    frameCount_ = 0;
+    committedState_.clear();
+    committedEntry_.clear();
+}
+
+void ViterbiDecoder::decodeFrame(const double* posteriors){
+
+    const float entryLog = log(1.0/words_.size()) + wordPenalty_;
+    const float exitLog = log(1 - SELFLOOPPROBABILITY);
+    clock_t start = clock();
+
+    //state scores live at index 1, index 0 is the LOGZERO neighbour of state 0
+    float* previous = &previousScore_[1];
+    float* current = &currentScore_[1];
+
+    //keep the ring buffer bounded by committing its oldest half
+    if(ringCount_ == tracebackDepth_){
+        int bestState = 0;
+        for(int s = 1; s < numStates_; s++){
+            if(previous[s] > previous[bestState])
+                bestState = s;
+        }
+        commitFrames(tracebackDepth_/2, bestState);
+        pruneUncommittedStates(previous);
+    }
+    int slot = (ringHead_ + ringCount_) % tracebackDepth_;
+    unsigned char* bp = &backPointer_[slot*paddedStates_];
+
+    //best word end of the previous frame, the utterance start acts as a word end at the first frame
+    float bestExit = 0;
+    int bestExitState = -1;
+    if(frameCount_ > 0){
+        bestExit = LOGZERO;
+        for(size_t w = 0; w < words_.size(); w++){
+            float score = previous[wordEnd_[w]] + exitLog;
+            if(score > bestExit){
+                bestExit = score;
+                bestExitState = wordEnd_[w];
+            }
+        }
+    }
+    exitState_[slot] = bestExitState;
+
+    for(size_t c = 0; c < logPosterior_.size(); c++){
+        double p = posteriors[c];
+        logPosterior_[c] = log(p > 1e-10 ? p : 1e-10);
+    }
+    for(int s = 0; s < paddedStates_; s++){
+        emission_[s] = logPosterior_[stateClass_[s]-1];
+    }
+
+    //max-plus recursion within words: stay in the state or advance from the previous one
+    int s = 0;
+#ifdef __SSE2__
+    for(; s < paddedStates_; s += 4){
+        __m128 fromSelf = _mm_add_ps(_mm_loadu_ps(previous+s), _mm_loadu_ps(&selfLog_[s]));
+        __m128 fromPrevious = _mm_add_ps(_mm_loadu_ps(previous+s-1), _mm_loadu_ps(&enterLog_[s]));
+        int moved = _mm_movemask_ps(_mm_cmpgt_ps(fromPrevious, fromSelf));
+        _mm_storeu_ps(current+s, _mm_max_ps(fromSelf, fromPrevious));
+        bp[s] = moved & 1;
+        bp[s+1] = (moved >> 1) & 1;
+        bp[s+2] = (moved >> 2) & 1;
+        bp[s+3] = (moved >> 3) & 1;
+    }
+#endif
+    for(; s < paddedStates_; s++){
+        float fromSelf = previous[s] + selfLog_[s];
+        float fromPrevious = previous[s-1] + enterLog_[s];
+        bp[s] = (fromPrevious > fromSelf);
+        current[s] = bp[s] ? fromPrevious : fromSelf;
+    }
+
+    //word entries from the best word end
+    for(size_t w = 0; w < words_.size(); w++){
+        float score = bestExit + entryLog;
+        if(score > current[wordStart_[w]]){
+            current[wordStart_[w]] = score;
+            bp[wordStart_[w]] = 2;
+        }
+    }
+
+    //add the emission scores and find the best state for the beam
+    float best = LOGZERO;
+    s = 0;
+#ifdef __SSE2__
+    __m128 bestVector = _mm_set1_ps(LOGZERO);
+    for(; s < paddedStates_; s += 4){
+        __m128 score = _mm_add_ps(_mm_loadu_ps(current+s), _mm_loadu_ps(&emission_[s]));
+        _mm_storeu_ps(current+s, score);
+        bestVector = _mm_max_ps(bestVector, score);
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, bestVector);
+    best = max(max(lanes[0], lanes[1]), max(lanes[2], lanes[3]));
+#endif
+    for(; s < paddedStates_; s++){
+        current[s] = current[s] + emission_[s];
+        best = max(best, current[s]);
+    }
+
+    //beam pruning
+    float threshold = best - beam_;
+    s = 0;
+#ifdef __SSE2__
+    __m128 thresholdVector = _mm_set1_ps(threshold);
+    __m128 zeroVector = _mm_set1_ps(LOGZERO);
+    for(; s < paddedStates_; s += 4){
+        __m128 score = _mm_loadu_ps(current+s);
+        __m128 keep = _mm_cmpge_ps(score, thresholdVector);
+        _mm_storeu_ps(current+s, _mm_or_ps(_mm_and_ps(keep, score), _mm_andnot_ps(keep, zeroVector)));
+    }
+#endif
+    for(; s < paddedStates_; s++){
+        if(current[s] < threshold)
+            current[s] = LOGZERO;
+    }
+
+    ringCount_ = ringCount_ + 1;
+    frameCount_ = frameCount_ + 1;
+    previousScore_.swap(currentScore_);
+    decodingSeconds_ = decodingSeconds_ + (double)(clock() - start)/CLOCKS_PER_SEC;
+    decodedFrames_ = decodedFrames_ + 1;
+
+    #ifdef VITERBI_DECODER_DEBUG_INFO
+        cout << "frame: " << frameCount_-1 << " best score: " << best << endl;
+    #endif
+}
+
+void ViterbiDecoder::finishDecoding(){
+
+    //finish on the best word end, or the best state if no word end survived the beam
+    if(ringCount_ > 0){
+        float* previous = &previousScore_[1];
+        int finalState = wordEnd_[0];
+        for(size_t w = 1; w < words_.size(); w++){
+            if(previous[wordEnd_[w]] > previous[finalState])
+                finalState = wordEnd_[w];
+        }
+        if(previous[finalState] <= LOGZERO){
+            for(int s = 0; s < numStates_; s++){
+                if(previous[s] > previous[finalState])
+                    finalState = s;
+            }
+        }
+        commitFrames(ringCount_, finalState);
+    }
+}
+
+void ViterbiDecoder::printResult(){
+
+    cout << "Decoded words:";
+    for(size_t f = 0; f < committedState_.size(); f++){
+        if(committedEntry_[f])
+            cout << " " << words_[stateWord_[committedState_[f]]];
+    }
+    cout << endl;
+
+    cout << "Decoded classes:";
+    for(size_t f = 0; f < committedState_.size(); f++){
+        if(f == 0 || committedEntry_[f] || committedState_[f] != committedState_[f-1])
+            cout << " " << stateClass_[committedState_[f]];
+    }
+    cout << endl;
+}
+
+void ViterbiDecoder::printDecodingSpeed(){
+    cout << "Viterbi decoder processed " << decodedFrames_ << " frames in " << decodingSeconds_ << " seconds" << endl;
+    if(decodingSeconds_ > 0)
+        cout << "Viterbi decoder speed: " << decodedFrames_/decodingSeconds_ << " frames/sec" << endl;
+}
@@ -0,0 +1,81 @@
+#ifndef VITERBIDECODER_H
+#define VITERBIDECODER_H
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <ctime>
+#include <cmath>
+
+using namespace std;
+
+#define DECODERBEAM 20.0
+#define WORDINSERTIONPENALTY 0.0
+#define SELFLOOPPROBABILITY 0.5
+#define TRACEBACKDEPTH 200
+#define LOGZERO -1.0e30f
+
+//#define VITERBI_DECODER_DEBUG_INFO
+
+
+/* ***************************************************************************************
+ * Log domain Viterbi search over a lexicon graph. Every word of the lexicon is a left to
+ * right HMM whose states emit one class (output node) of the Neural Network, and any word
+ * can follow any other word. Frames are decoded one at a time with decodeFrame() between
+ * startDecoding() and finishDecoding(); back pointers are kept in a ring buffer of TRACEBACKDEPTH
+ * frames, so memory does not grow with the length of the utterance.
+*/
+class ViterbiDecoder
+{
+    void commitFrames(int numFrames, int lastState);
+    void pruneUncommittedStates(float* scores);
+
+    //lexicon graph, states of a word are stored one after the other
+    std::vector<string> words_;
+    std::vector<int> wordStart_;
+    std::vector<int> wordEnd_;
+    std::vector<int> stateClass_;
+    std::vector<int> stateWord_;
+    std::vector<float> selfLog_;
+    std::vector<float> enterLog_;
+    int numStates_;
+    int paddedStates_;
+
+    //scores of the previous and current frame, element 0 is padding for the shifted load
+    std::vector<float> previousScore_;
+    std::vector<float> currentScore_;
+    std::vector<float> emission_;
+    std::vector<float> logPosterior_;
+
+    //traceback ring buffer: back pointer of every state and best word end of every frame
+    std::vector<unsigned char> backPointer_;
+    std::vector<int> exitState_;
+    int ringHead_;
+    int ringCount_;
+    size_t frameCount_;
+
+    //decoding result
+    std::vector<int> committedState_;
+    std::vector<unsigned char> committedEntry_;
+
+    //statistics used to report the decoding speed
+    double decodedFrames_;
+    double decodingSeconds_;
+
+public:
+    ViterbiDecoder();
+    void loadLexicon(const char* fileName);
+    void startDecoding(int numClasses);
+    void decodeFrame(const double* posteriors);
+    void finishDecoding();
+    void printResult();
+    void printDecodingSpeed();
+    double beam_;
+    double wordPenalty_;
+    int tracebackDepth_;
+};
+
+#endif // VITERBIDECODER_H